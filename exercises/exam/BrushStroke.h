@@ -0,0 +1,176 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_BRUSH_STROKE_H
+#define ITU_GRAPHICS_PROGRAMMING_BRUSH_STROKE_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include "glad/glad.h"
+#include "glm/vec2.hpp"
+#include "Color.h"
+#include "Rect.h"
+#include "TiledCanvas.h"
+#include "UndoHistory.h"
+
+// blend 4 pixels per instruction with SSE2 when the compiler allows it, one at a time otherwise
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#include <emmintrin.h>
+#define BRUSH_STROKE_SSE
+#endif
+
+// paints strokes with a round brush on a TiledCanvas.
+// the brush is a coverage mask computed once per size, with a smooth edge, that is blended into the canvas ("stamped")
+// row by row, one tile at a time. a stroke doesn't only stamp where the cursor was reported but every few pixels along
+// the way between those points, so fast movements still give a continuous line
+class BrushStroke
+{
+    // the brush is diameter x diameter pixels, 4 coverage values per pixel (the same for the 4 channels) so that rows
+    // of the mask and of the image can be blended byte by byte
+    int diameter = 0;
+    std::vector<GLubyte> mask;
+    // color of the stroke, alpha is always 255
+    GLubyte color[4] = { 0, 0, 0, 255 };
+    // distance between stamps, and how far the stroke went since its last stamp
+    float spacing = 1.0f;
+    float travelled = 0.0f;
+    glm::vec2 last;
+    bool active = false;
+    // where the stamps save what they paint over, if anywhere
+    UndoHistory *history = nullptr;
+
+    void setSize( int size )
+    {
+        if ( size + 1 == diameter )
+            return;
+        // a brush of size n covers n + 1 pixels across, like the square brush it replaces
+        diameter = size + 1;
+        mask.assign( size_t( diameter ) * diameter * 4, 0 );
+        float radius = diameter * 0.5f;
+        for ( int y = 0; y < diameter; y++ )
+        {
+            for ( int x = 0; x < diameter; x++ )
+            {
+                // the part of the pixel inside the circle, approximated over a pixel wide band along the edge
+                float distance = std::sqrt(( x + 0.5f - radius ) * ( x + 0.5f - radius ) +
+                                           ( y + 0.5f - radius ) * ( y + 0.5f - radius ));
+                float coverage = std::min( std::max( radius - distance + 0.5f, 0.0f ), 1.0f );
+                std::fill_n( &mask[( size_t( y ) * diameter + x ) * 4], 4, (GLubyte) ( coverage * 255.0f + 0.5f ));
+            }
+        }
+        // close enough for the stamps to overlap into a smooth line
+        spacing = std::max( 1.0f, diameter * 0.25f );
+    }
+
+    // blends count pixels of color into dst, by the coverage in cov: dst + (color - dst) * cov / 255, rounded.
+    // written as (dst * (255 - cov) + color * cov + 128) / 255 it fits in 16 bits, and / 255 is done exactly with
+    // (t + (t >> 8)) >> 8
+    static void blendRow( GLubyte *dst, const GLubyte *cov, const GLubyte *color, int count )
+    {
+        int i = 0;
+#if defined(BRUSH_STROKE_SSE)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i full = _mm_set1_epi16( 255 );
+        const __m128i half = _mm_set1_epi16( 128 );
+        // the color repeated for 2 pixels, as 16 bit values
+        int packed;
+        memcpy( &packed, color, 4 );
+        const __m128i source16 = _mm_unpacklo_epi8( _mm_set1_epi32( packed ), zero );
+        for ( ; i + 4 <= count; i += 4 )
+        {
+            __m128i d = _mm_loadu_si128((const __m128i *) ( dst + i * 4 ));
+            __m128i c = _mm_loadu_si128((const __m128i *) ( cov + i * 4 ));
+            __m128i result[2];
+            for ( int part = 0; part < 2; part++ )
+            {
+                __m128i d16 = part == 0 ? _mm_unpacklo_epi8( d, zero ) : _mm_unpackhi_epi8( d, zero );
+                __m128i c16 = part == 0 ? _mm_unpacklo_epi8( c, zero ) : _mm_unpackhi_epi8( c, zero );
+                __m128i t = _mm_add_epi16( _mm_mullo_epi16( d16, _mm_sub_epi16( full, c16 )),
+                                           _mm_mullo_epi16( source16, c16 ));
+                t = _mm_add_epi16( t, half );
+                result[part] = _mm_srli_epi16( _mm_add_epi16( t, _mm_srli_epi16( t, 8 )), 8 );
+            }
+            _mm_storeu_si128((__m128i *) ( dst + i * 4 ), _mm_packus_epi16( result[0], result[1] ));
+        }
+#endif
+        for ( ; i < count; i++ )
+        {
+            for ( int k = 0; k < 4; k++ )
+            {
+                unsigned int t = dst[i * 4 + k] * ( 255u - cov[i * 4 + k] ) + color[k] * cov[i * 4 + k] + 128u;
+                dst[i * 4 + k] = (GLubyte) (( t + ( t >> 8 )) >> 8 );
+            }
+        }
+    }
+
+    // stamps the brush centered at position, returns the pixels it touched
+    Rect stamp( TiledCanvas &canvas, glm::vec2 position )
+    {
+        int x0 = (int) std::floor( position.x ) - diameter / 2;
+        int y0 = (int) std::floor( position.y ) - diameter / 2;
+        // only the part of the brush inside the image, clipped once for the whole stamp
+        Rect rect = Rect( x0, y0, x0 + diameter, y0 + diameter ).clamped( canvas.width(), canvas.height());
+        if ( rect.isEmpty())
+            return rect;
+        if ( history )
+            history->save( rect );
+        for ( int y = rect.y0; y < rect.y1; y++ )
+        {
+            // the row of the stamp, split where it crosses into the next tile
+            for ( int x = rect.x0; x < rect.x1; )
+            {
+                int next = std::min( rect.x1, ( x | ( TiledCanvas::tileSize - 1 )) + 1 );
+                const GLubyte *cov = &mask[( size_t( y - y0 ) * diameter + ( x - x0 )) * 4];
+                blendRow( canvas.writableRow( x, y ), cov, color, next - x );
+                x = next;
+            }
+        }
+        return rect;
+    }
+
+public:
+    // starts a stroke of the given brush size and color at position, with a first stamp there. every stamp of the
+    // stroke is saved in history, if given, before it is blended
+    Rect begin( TiledCanvas &canvas, glm::vec2 position, int size, Color brushColor, UndoHistory *history = nullptr )
+    {
+        this->history = history;
+        setSize( std::max( size, 0 ));
+        color[0] = brushColor.r;
+        color[1] = brushColor.g;
+        color[2] = brushColor.b;
+        color[3] = 255;
+        last = position;
+        travelled = 0.0f;
+        active = true;
+        return stamp( canvas, position );
+    }
+
+    // continues the stroke in a straight line to position, stamping every spacing pixels. the distance left after the
+    // last stamp carries over to the next segment, so the stamps are evenly spaced along the whole stroke
+    Rect lineTo( TiledCanvas &canvas, glm::vec2 position )
+    {
+        Rect changed;
+        if ( !active )
+            return changed;
+        glm::vec2 delta = position - last;
+        float length = std::sqrt( delta.x * delta.x + delta.y * delta.y );
+        float along = spacing - travelled;
+        for ( ; along <= length; along += spacing )
+            changed.include( stamp( canvas, last + delta * ( along / length )));
+        travelled = length - ( along - spacing );
+        last = position;
+        return changed;
+    }
+
+    void end()
+    {
+        active = false;
+        history = nullptr;
+    }
+
+    bool isActive() const
+    {
+        return active;
+    }
+};
+
+#endif //ITU_GRAPHICS_PROGRAMMING_BRUSH_STROKE_H
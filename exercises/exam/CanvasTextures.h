@@ -0,0 +1,205 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_CANVAS_TEXTURES_H
+#define ITU_GRAPHICS_PROGRAMMING_CANVAS_TEXTURES_H
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include "glad/glad.h"
+#include "TiledCanvas.h"
+
+// the textures a TiledCanvas is drawn from. only the tiles that aren't blank are on the GPU, each in a slot of an
+// array texture whose layers hold atlasTiles x atlasTiles tiles, and a second texture with one texel per tile of the
+// canvas says which slot it is in (slot + 1, 0 for a blank tile). the shaders look up the tile of a pixel there first
+// (canvasColor, see shaderFunctions), so the canvas takes video memory in proportion to the painted area too.
+// only the tiles the canvas marked as dirty are uploaded, a whole tile each
+class CanvasTextures
+{
+public:
+    static const int atlasTiles = 16;
+    static const int tilesPerLayer = atlasTiles * atlasTiles;
+    static const int layerSize = atlasTiles * TiledCanvas::tileSize;
+
+private:
+    GLuint atlas = 0;
+    GLuint slots = 0;
+    int layers = 0;
+    // the most layers the array texture can have: GL_MAX_ARRAY_TEXTURE_LAYERS, or fewer if the GPU ran out of memory
+    int maxLayers = 0;
+    // slot of each tile of the canvas, -1 for the blank ones
+    std::vector<int> slotOf;
+    std::vector<int> freeSlots;
+    int usedSlots = 0;
+
+    void uploadTile( const TiledCanvas &canvas, int tile )
+    {
+        int slot = slotOf[tile];
+        glBindTexture( GL_TEXTURE_2D_ARRAY, atlas );
+        glTexSubImage3D( GL_TEXTURE_2D_ARRAY, 0, ( slot % atlasTiles ) * TiledCanvas::tileSize,
+                         ( slot / atlasTiles % atlasTiles ) * TiledCanvas::tileSize, slot / tilesPerLayer,
+                         TiledCanvas::tileSize, TiledCanvas::tileSize, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                         canvas.tilePixels( tile ).data());
+    }
+
+    void setSlot( const TiledCanvas &canvas, int tile, int value )
+    {
+        glBindTexture( GL_TEXTURE_2D, slots );
+        glTexSubImage2D( GL_TEXTURE_2D, 0, tile % canvas.tilesAcross(), tile / canvas.tilesAcross(), 1, 1,
+                         GL_RED_INTEGER, GL_INT, &value );
+    }
+
+    // makes room for at least count slots, the array texture can't grow in place so the tiles are uploaded again.
+    // once it has as many layers as it can have it stays as it is
+    void reserve( const TiledCanvas &canvas, int count )
+    {
+        if ( count <= layers * tilesPerLayer || layers >= maxLayers )
+            return;
+        int needed = ( count + tilesPerLayer - 1 ) / tilesPerLayer;
+        int grown = std::min( std::max( needed, layers * 2 ), maxLayers );
+
+        if ( atlas == 0 )
+            glGenTextures( 1, &atlas );
+        glBindTexture( GL_TEXTURE_2D_ARRAY, atlas );
+        // earlier errors are dropped, so that the one checked below comes from glTexImage3D
+        for ( int i = 0; i < 16 && glGetError() != GL_NO_ERROR; i++ )
+            ;
+        glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerSize, layerSize, grown, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                      nullptr );
+        if ( glGetError() == GL_OUT_OF_MEMORY )
+        {
+            // the texture is undefined after that, it gets back the layers it had and doesn't try to grow again
+            maxLayers = layers;
+            if ( layers > 0 )
+                glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, layerSize, layerSize, layers, 0, GL_RGBA,
+                              GL_UNSIGNED_BYTE, nullptr );
+        } else
+            layers = grown;
+        glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0 );
+        for ( size_t tile = 0; tile < slotOf.size(); tile++ )
+        {
+            // tiles later in the dirty list may have become blank, they give their slot back then
+            if ( slotOf[tile] >= 0 && !canvas.tilePixels( tile ).empty())
+                uploadTile( canvas, (int) tile );
+        }
+    }
+
+public:
+    // whether the GPU can hold the textures of a canvas of width x height pixels: the texture of the slots has one
+    // texel per tile, it can't be wider or taller than GL_MAX_TEXTURE_SIZE
+    static bool fits( int width, int height )
+    {
+        GLint maxSize = 0;
+        glGetIntegerv( GL_MAX_TEXTURE_SIZE, &maxSize );
+        return ( width - 1 ) / TiledCanvas::tileSize < maxSize && ( height - 1 ) / TiledCanvas::tileSize < maxSize;
+    }
+
+    // textures for a blank canvas of the size of canvas
+    void create( const TiledCanvas &canvas )
+    {
+        destroy();
+        glGetIntegerv( GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers );
+        slotOf.assign( size_t( canvas.tilesAcross()) * canvas.tilesDown(), -1 );
+        std::vector<GLint> blank( slotOf.size(), 0 );
+        glGenTextures( 1, &slots );
+        glBindTexture( GL_TEXTURE_2D, slots );
+        glTexImage2D( GL_TEXTURE_2D, 0, GL_R32I, canvas.tilesAcross(), canvas.tilesDown(), 0, GL_RED_INTEGER, GL_INT,
+                      blank.data());
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+        glBindTexture( GL_TEXTURE_2D, 0 );
+    }
+
+    void destroy()
+    {
+        if ( atlas )
+            glDeleteTextures( 1, &atlas );
+        if ( slots )
+            glDeleteTextures( 1, &slots );
+        atlas = slots = 0;
+        layers = maxLayers = 0;
+        slotOf.clear();
+        freeSlots.clear();
+        usedSlots = 0;
+    }
+
+    // uploads the tiles changed since the last upload: a tile that became blank gives its slot back, one that stopped
+    // being blank gets a slot
+    void upload( TiledCanvas &canvas )
+    {
+        for ( int tile : canvas.dirtyTiles())
+        {
+            bool blank = canvas.tilePixels( tile ).empty();
+            int &slot = slotOf[tile];
+            if ( blank )
+            {
+                if ( slot >= 0 )
+                {
+                    freeSlots.push_back( slot );
+                    slot = -1;
+                    setSlot( canvas, tile, 0 );
+                }
+                continue;
+            }
+            if ( slot < 0 )
+            {
+                if ( freeSlots.empty())
+                {
+                    // past the last layer the GPU allows the tile can't be shown, the canvas keeps it anyway
+                    reserve( canvas, usedSlots + 1 );
+                    if ( usedSlots >= layers * tilesPerLayer )
+                        continue;
+                    slot = usedSlots++;
+                } else
+                {
+                    slot = freeSlots.back();
+                    freeSlots.pop_back();
+                }
+                setSlot( canvas, tile, slot + 1 );
+            }
+            uploadTile( canvas, tile );
+        }
+        canvas.clearDirty();
+        glBindTexture( GL_TEXTURE_2D_ARRAY, 0 );
+        glBindTexture( GL_TEXTURE_2D, 0 );
+    }
+
+    // binds the array texture to unit 0 and the slots to unit 1, the canvas and tiles samplers of the shaders
+    void bind() const
+    {
+        glActiveTexture( GL_TEXTURE0 );
+        glBindTexture( GL_TEXTURE_2D_ARRAY, atlas );
+        glActiveTexture( GL_TEXTURE1 );
+        glBindTexture( GL_TEXTURE_2D, slots );
+        glActiveTexture( GL_TEXTURE0 );
+    }
+
+    // the GLSL the fragment shaders read the canvas with, given to every Shader that draws it (as its fragmentHeader)
+    // so that the layout of the textures is written in one place: the samplers, the size of the canvas in pixels and
+    // canvasColor( uv ), the color of the pixel at uv
+    static std::string shaderFunctions()
+    {
+        return "uniform sampler2DArray canvas;\n"
+               "uniform isampler2D tiles;\n"
+               "uniform vec2 canvasSize;\n"
+               "const int tileSize = " + std::to_string( TiledCanvas::tileSize ) + ";\n"
+               "const int atlasTiles = " + std::to_string( atlasTiles ) + ";\n"
+               "vec4 canvasColor(vec2 uv)\n"
+               "{\n"
+               "    ivec2 pixel = clamp(ivec2(floor(uv * canvasSize)), ivec2(0), ivec2(canvasSize) - 1);\n"
+               "    int slot = texelFetch(tiles, pixel / tileSize, 0).r - 1;\n"
+               "    if (slot < 0)\n"
+               "        return vec4(1.0);\n"
+               "    ivec2 inLayer = ivec2(slot % atlasTiles, slot / atlasTiles % atlasTiles) * tileSize + pixel % tileSize;\n"
+               "    return texelFetch(canvas, ivec3(inLayer, slot / (atlasTiles * atlasTiles)), 0);\n"
+               "}\n";
+    }
+
+    // video memory of the array texture
+    size_t gpuBytes() const
+    {
+        return size_t( layers ) * layerSize * layerSize * 4;
+    }
+};
+
+#endif //ITU_GRAPHICS_PROGRAMMING_CANVAS_TEXTURES_H
@@ -0,0 +1,169 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_FLOOD_FILLER_H
+#define ITU_GRAPHICS_PROGRAMMING_FLOOD_FILLER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include "glad/glad.h"
+#include "Color.h"
+#include "Rect.h"
+#include "TiledCanvas.h"
+#include "UndoHistory.h"
+
+// scanline flood fill of a TiledCanvas.
+// instead of visiting the pixels one at a time, each step fills a whole horizontal run of the target color and then
+// looks at the rows above and below it, keeping a single seed for each run it finds there. a seed remembers the run it
+// was found from, so that its row is only searched again beyond the ends of that run (the rest of it was just filled).
+// pixels are compared as packed 32 bit values, ignoring alpha like the Color comparisons in main.cpp, and rows are
+// read and written one tile at a time. blank tiles are only read, they get pixels when the fill reaches them
+class FloodFiller
+{
+    struct Seed
+    {
+        int x;
+        int y;
+        // the run [parentLeft, parentRight) of row y - dy the seed was found from, dy is 0 for the first seed
+        int parentLeft;
+        int parentRight;
+        int dy;
+    };
+
+    // kept between fills, it only grows with the number of runs waiting to be filled
+    std::vector<Seed> seeds;
+
+    static uint32_t load( const GLubyte *pixel )
+    {
+        uint32_t value;
+        memcpy( &value, pixel, 4 );
+        return value;
+    }
+
+    static void store( GLubyte *pixel, uint32_t value )
+    {
+        memcpy( pixel, &value, 4 );
+    }
+
+    static const int tileMask = TiledCanvas::tileSize - 1;
+
+    // the first pixel of the run of the target color that ends at right (excluded) in row y
+    static int runStart( const TiledCanvas &canvas, int right, int y, uint32_t mask, uint32_t target )
+    {
+        while ( right > 0 )
+        {
+            int start = ( right - 1 ) & ~tileMask;
+            const GLubyte *row = canvas.row( start, y );
+            int i = right;
+            while ( i > start && ( load( row + ( i - 1 - start ) * 4 ) & mask ) == target )
+                i--;
+            if ( i > start )
+                return i;
+            right = start;
+        }
+        return 0;
+    }
+
+    // the pixel after the run of the target color that starts at left in row y
+    static int runEnd( const TiledCanvas &canvas, int left, int y, uint32_t mask, uint32_t target )
+    {
+        while ( left < canvas.width())
+        {
+            int start = left & ~tileMask;
+            int end = std::min( start + TiledCanvas::tileSize, canvas.width());
+            const GLubyte *row = canvas.row( start, y );
+            int i = left;
+            while ( i < end && ( load( row + ( i - start ) * 4 ) & mask ) == target )
+                i++;
+            if ( i < end )
+                return i;
+            left = end;
+        }
+        return canvas.width();
+    }
+
+    // pushes a seed for each run of the target color in [from, to) of row y, found from the run [left, right) of row
+    // y - dy
+    void pushRuns( const TiledCanvas &canvas, int from, int to, int y, int left, int right, int dy, uint32_t mask,
+                   uint32_t target )
+    {
+        bool inRun = false;
+        for ( int start = from; start < to; )
+        {
+            int end = std::min(( start | tileMask ) + 1, to );
+            const GLubyte *row = canvas.row( start, y );
+            for ( int i = start; i < end; i++ )
+            {
+                bool matches = ( load( row + ( i - start ) * 4 ) & mask ) == target;
+                if ( matches && !inRun )
+                    seeds.push_back( { i, y, left, right, dy } );
+                inRun = matches;
+            }
+            start = end;
+        }
+    }
+
+public:
+    // fills the area of the color of pixel (x, y) connected to it with replacement (and alpha 255). returns the
+    // bounding box of the pixels that changed, empty if none did. each run is saved in history, if given, before it is
+    // filled
+    Rect fill( TiledCanvas &canvas, int x, int y, Color replacement, UndoHistory *history = nullptr )
+    {
+        if ( x < 0 || x >= canvas.width() || y < 0 || y >= canvas.height())
+            return Rect();
+
+        // same bytes as the pixels, so the masks work with either byte order
+        const GLubyte rgb[4] = { 255, 255, 255, 0 };
+        const GLubyte color[4] = { replacement.r, replacement.g, replacement.b, 255 };
+        const uint32_t mask = load( rgb );
+        const uint32_t value = load( color );
+        const uint32_t target = canvas.pixel( x, y ) & mask;
+        if (( value & mask ) == target )
+            return Rect();
+
+        Rect changed;
+        seeds.clear();
+        seeds.push_back( { x, y, 0, 0, 0 } );
+        while ( !seeds.empty())
+        {
+            Seed seed = seeds.back();
+            seeds.pop_back();
+            // another run may have reached it since it was pushed
+            if (( canvas.pixel( seed.x, seed.y ) & mask ) != target )
+                continue;
+
+            // the run of the target color the seed is in
+            int left = runStart( canvas, seed.x, seed.y, mask, target );
+            int right = runEnd( canvas, seed.x + 1, seed.y, mask, target );
+            if ( history )
+                history->save( Rect( left, seed.y, right, seed.y + 1 ));
+            for ( int start = left; start < right; )
+            {
+                int end = std::min(( start | tileMask ) + 1, right );
+                GLubyte *row = canvas.writableRow( start, seed.y );
+                for ( int i = start; i < end; i++ )
+                    store( row + ( i - start ) * 4, value );
+                start = end;
+            }
+            changed.include( Rect( left, seed.y, right, seed.y + 1 ));
+
+            // one seed for each run of the target color touching [left, right) in the rows above and below. in the row
+            // of the parent, the part under the parent run is already filled
+            for ( int dy = -1; dy <= 1; dy += 2 )
+            {
+                int ny = seed.y + dy;
+                if ( ny < 0 || ny >= canvas.height())
+                    continue;
+                if ( dy == -seed.dy )
+                {
+                    pushRuns( canvas, left, seed.parentLeft, ny, left, right, dy, mask, target );
+                    pushRuns( canvas, seed.parentRight, right, ny, left, right, dy, mask, target );
+                }
+                else
+                    pushRuns( canvas, left, right, ny, left, right, dy, mask, target );
+            }
+        }
+        return changed;
+    }
+};
+
+#endif //ITU_GRAPHICS_PROGRAMMING_FLOOD_FILLER_H
@@ -0,0 +1,62 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RECT_H
+#define ITU_GRAPHICS_PROGRAMMING_RECT_H
+
+#include <algorithm>
+
+// rectangle of pixels of the image, from (x0, y0) included to (x1, y1) excluded
+struct Rect
+{
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = 0;
+    int y1 = 0;
+
+    Rect() = default;
+
+    Rect( int x0, int y0, int x1, int y1 )
+    {
+        this->x0 = x0;
+        this->y0 = y0;
+        this->x1 = x1;
+        this->y1 = y1;
+    }
+
+    bool isEmpty() const
+    {
+        return x0 >= x1 || y0 >= y1;
+    }
+
+    int width() const
+    {
+        return x1 - x0;
+    }
+
+    int height() const
+    {
+        return y1 - y0;
+    }
+
+    // grows the rectangle to cover other too
+    void include( const Rect &other )
+    {
+        if ( other.isEmpty())
+            return;
+        if ( isEmpty())
+        {
+            *this = other;
+            return;
+        }
+        x0 = std::min( x0, other.x0 );
+        y0 = std::min( y0, other.y0 );
+        x1 = std::max( x1, other.x1 );
+        y1 = std::max( y1, other.y1 );
+    }
+
+    // the part of the rectangle inside an image of the given size
+    Rect clamped( int width, int height ) const
+    {
+        return Rect( std::max( x0, 0 ), std::max( y0, 0 ), std::min( x1, width ), std::min( y1, height ));
+    }
+};
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RECT_H
@@ -0,0 +1,162 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_TILED_CANVAS_H
+#define ITU_GRAPHICS_PROGRAMMING_TILED_CANVAS_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "glad/glad.h"
+#include "Rect.h"
+
+// the RGBA image painted on, split in tiles of tileSize x tileSize pixels stored one after the other, 4 bytes per
+// pixel and row after row inside a tile. a tile nobody painted on is blank: it has no pixels, it reads as white and
+// only gets memory the first time something writes to it, so the size of the canvas costs almost nothing until it
+// is painted. the tiles that were written to since the last upload are kept in a list, they are all the GPU needs.
+// pixels are reached a tile row at a time: row( x, y ) points to pixel (x, y), and the pixels after it up to the end
+// of its tile follow in memory
+class TiledCanvas
+{
+public:
+    static const int tileShift = 6;
+    static const int tileSize = 1 << tileShift;
+    static const size_t tileBytes = size_t( tileSize ) * tileSize * 4;
+
+private:
+    int w = 0;
+    int h = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    // pixels of each tile, empty for the blank ones
+    std::vector<std::vector<GLubyte>> tiles;
+    std::vector<int> dirty;
+    std::vector<bool> isDirty;
+    size_t allocated = 0;
+
+    static const GLubyte *blankRow()
+    {
+        static std::vector<GLubyte> white( size_t( tileSize ) * 4, 255 );
+        return white.data();
+    }
+
+    void markDirty( int tile )
+    {
+        if ( isDirty[tile] )
+            return;
+        isDirty[tile] = true;
+        dirty.push_back( tile );
+    }
+
+public:
+    // a blank canvas of width x height pixels, forgetting everything painted before
+    void reset( int width, int height )
+    {
+        w = width;
+        h = height;
+        tilesX = ( width + tileSize - 1 ) / tileSize;
+        tilesY = ( height + tileSize - 1 ) / tileSize;
+        tiles.assign( size_t( tilesX ) * tilesY, std::vector<GLubyte>());
+        dirty.clear();
+        isDirty.assign( tiles.size(), false );
+        allocated = 0;
+    }
+
+    int width() const
+    {
+        return w;
+    }
+
+    int height() const
+    {
+        return h;
+    }
+
+    int tilesAcross() const
+    {
+        return tilesX;
+    }
+
+    int tilesDown() const
+    {
+        return tilesY;
+    }
+
+    // the tile pixel (x, y) is in
+    int tileAt( int x, int y ) const
+    {
+        return ( y >> tileShift ) * tilesX + ( x >> tileShift );
+    }
+
+    // the pixels of the canvas covered by a tile
+    Rect tileRect( int tile ) const
+    {
+        int x = ( tile % tilesX ) * tileSize;
+        int y = ( tile / tilesX ) * tileSize;
+        return Rect( x, y, x + tileSize, y + tileSize ).clamped( w, h );
+    }
+
+    // pixel (x, y), followed by the rest of its row inside the tile, white for blank tiles
+    const GLubyte *row( int x, int y ) const
+    {
+        const std::vector<GLubyte> &tile = tiles[tileAt( x, y )];
+        if ( tile.empty())
+            return blankRow();
+        return tile.data() + ((( y & ( tileSize - 1 )) << tileShift ) + ( x & ( tileSize - 1 ))) * 4;
+    }
+
+    // the same as row, for writing: a blank tile gets its pixels (white) here, and the tile is marked for upload
+    GLubyte *writableRow( int x, int y )
+    {
+        int index = tileAt( x, y );
+        std::vector<GLubyte> &tile = tiles[index];
+        if ( tile.empty())
+        {
+            tile.assign( tileBytes, 255 );
+            allocated += tileBytes;
+        }
+        markDirty( index );
+        return tile.data() + ((( y & ( tileSize - 1 )) << tileShift ) + ( x & ( tileSize - 1 ))) * 4;
+    }
+
+    // pixel (x, y) as it is in memory
+    uint32_t pixel( int x, int y ) const
+    {
+        uint32_t value;
+        memcpy( &value, row( x, y ), 4 );
+        return value;
+    }
+
+    // the pixels of a tile, empty if it is blank
+    const std::vector<GLubyte> &tilePixels( int tile ) const
+    {
+        return tiles[tile];
+    }
+
+    // exchanges the pixels of a tile with pixels, which must be empty (blank) or hold a whole tile
+    void swapTile( int tile, std::vector<GLubyte> &pixels )
+    {
+        allocated += pixels.size();
+        allocated -= tiles[tile].size();
+        tiles[tile].swap( pixels );
+        markDirty( tile );
+    }
+
+    // the tiles written to since clearDirty, in the order they were first written to
+    const std::vector<int> &dirtyTiles() const
+    {
+        return dirty;
+    }
+
+    void clearDirty()
+    {
+        for ( int tile : dirty )
+            isDirty[tile] = false;
+        dirty.clear();
+    }
+
+    // memory taken by the pixels of the tiles that aren't blank
+    size_t memoryBytes() const
+    {
+        return allocated;
+    }
+};
+
+#endif //ITU_GRAPHICS_PROGRAMMING_TILED_CANVAS_H
@@ -0,0 +1,158 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_UNDO_HISTORY_H
+#define ITU_GRAPHICS_PROGRAMMING_UNDO_HISTORY_H
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include "glad/glad.h"
+#include "Rect.h"
+#include "TiledCanvas.h"
+
+// undo and redo of the operations (strokes, fills) on a TiledCanvas. an operation only keeps a copy of the tiles it
+// changed, taken the first time it changes each of them (save must be called before writing to the pixels), and a
+// tile that was blank is kept as nothing at all. undoing an operation swaps its copies with the tiles of the canvas,
+// so the same copies then hold what redo puts back, and the history takes memory in proportion to the area changed,
+// not to the size of the canvas.
+// past the memory budget the oldest operations are forgotten
+class UndoHistory
+{
+    struct Tile
+    {
+        int index;
+        // the pixels of the tile that the canvas doesn't have at the moment, empty if that is a blank tile
+        std::vector<GLubyte> pixels;
+    };
+
+    struct Operation
+    {
+        std::vector<Tile> tiles;
+        size_t bytes = 0;
+    };
+
+    TiledCanvas &canvas;
+
+    std::deque<Operation> undoStack;
+    std::vector<Operation> redoStack;
+    Operation current;
+    bool recording = false;
+    // number of the operation each tile was last saved by, so each tile is copied once per operation
+    std::vector<unsigned int> savedBy;
+    unsigned int operation = 0;
+    size_t bytes = 0;
+    // how much memory the history can take, the oldest operations are forgotten past it
+    const size_t budget = size_t( 128 ) << 20;
+
+    // exchanges the copy in tile, one of the tiles of operation, with the tile of the canvas. returns the pixels that
+    // changed. either of them can be blank, so what the history holds changes by the difference
+    Rect swap( Operation &operation, Tile &tile )
+    {
+        size_t before = tile.pixels.size();
+        canvas.swapTile( tile.index, tile.pixels );
+        operation.bytes = operation.bytes - before + tile.pixels.size();
+        bytes = bytes - before + tile.pixels.size();
+        return canvas.tileRect( tile.index );
+    }
+
+    void forgetOldest()
+    {
+        while ( bytes > budget && !undoStack.empty())
+        {
+            bytes -= undoStack.front().bytes;
+            undoStack.pop_front();
+        }
+    }
+
+public:
+    explicit UndoHistory( TiledCanvas &canvas ) : canvas( canvas )
+    {
+    }
+
+    // starts recording an operation, everything saved until end is undone at once
+    void begin()
+    {
+        end();
+        recording = true;
+        operation++;
+        savedBy.resize( size_t( canvas.tilesAcross()) * canvas.tilesDown(), 0 );
+        // a new operation replaces whatever could be redone
+        for ( const Operation &redo : redoStack )
+            bytes -= redo.bytes;
+        redoStack.clear();
+    }
+
+    // copies the tiles under rect that the current operation hasn't copied yet. call it before changing the pixels
+    void save( const Rect &area )
+    {
+        if ( !recording )
+            return;
+        Rect rect = area.clamped( canvas.width(), canvas.height());
+        if ( rect.isEmpty())
+            return;
+        for ( int y = rect.y0 & ~( TiledCanvas::tileSize - 1 ); y < rect.y1; y += TiledCanvas::tileSize )
+        {
+            for ( int x = rect.x0 & ~( TiledCanvas::tileSize - 1 ); x < rect.x1; x += TiledCanvas::tileSize )
+            {
+                int index = canvas.tileAt( x, y );
+                if ( savedBy[index] == operation )
+                    continue;
+                savedBy[index] = operation;
+
+                current.tiles.push_back( { index, canvas.tilePixels( index ) } );
+                current.bytes += current.tiles.back().pixels.size() + sizeof( Tile );
+                bytes += current.tiles.back().pixels.size() + sizeof( Tile );
+            }
+        }
+    }
+
+    // finishes the current operation, if any. an operation that changed nothing isn't kept
+    void end()
+    {
+        if ( !recording )
+            return;
+        recording = false;
+        if ( current.tiles.empty())
+            return;
+        undoStack.push_back( std::move( current ));
+        current = Operation();
+        forgetOldest();
+    }
+
+    // puts back the image as it was before the last operation, returns the pixels that changed
+    Rect undo()
+    {
+        end();
+        Rect changed;
+        if ( undoStack.empty())
+            return changed;
+        Operation &last = undoStack.back();
+        for ( Tile &tile : last.tiles )
+            changed.include( swap( last, tile ));
+        redoStack.push_back( std::move( last ));
+        undoStack.pop_back();
+        return changed;
+    }
+
+    // does the last undone operation again, returns the pixels that changed
+    Rect redo()
+    {
+        end();
+        Rect changed;
+        if ( redoStack.empty())
+            return changed;
+        Operation &next = redoStack.back();
+        for ( Tile &tile : next.tiles )
+            changed.include( swap( next, tile ));
+        undoStack.push_back( std::move( next ));
+        redoStack.pop_back();
+        forgetOldest();
+        return changed;
+    }
+
+    // memory taken by the copies of the tiles, for the operations that can be undone and redone
+    size_t memoryBytes() const
+    {
+        return bytes;
+    }
+};
+
+#endif //ITU_GRAPHICS_PROGRAMMING_UNDO_HISTORY_H
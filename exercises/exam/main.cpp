@@ -2,11 +2,16 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <vector>
+#include <cstdlib>
 #include "shader.h"
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
-#include "Queue.h"
+#include "FloodFiller.h"
+#include "TiledCanvas.h"
+#include "CanvasTextures.h"
+#include "BrushStroke.h"
+#include "UndoHistory.h"
 #include "Vertex.h"
 #include "Color.h"
 
@@ -30,10 +35,12 @@ void mouse_button_callback( GLFWwindow *window, int button, int action, int mods
 const unsigned int SCR_WIDTH = 720;
 const unsigned int SCR_HEIGHT = 720;
 
-const unsigned int IMAGE_WIDTH = 1920;
-const unsigned int IMAGE_HEIGHT = 1920;
+// size of the canvas, unless given on the command line ("exam 16384 16384"). it only takes memory where it is painted
+const int DEFAULT_IMAGE_WIDTH = 1920;
+const int DEFAULT_IMAGE_HEIGHT = 1920;
 
-GLubyte image[IMAGE_WIDTH][IMAGE_HEIGHT][4];
+// the painting, split in tiles that get their pixels the first time they are painted on
+TiledCanvas image;
 
 // global variables used for rendering
 // -----------------------------------
@@ -79,12 +86,16 @@ void drawGui();
 
 void setupPlane();
 
-void FloodFill( int xPos, int yPos, Color targetColor, Color replacementColor );
+Rect FloodFill( int xPos, int yPos, Color replacementColor );
 
 void CalculateFrameRate( float lastFrame, float currentFrame );
 
-// 2d texture
-GLuint canvas;
+// the tiles of image that aren't blank, on the GPU
+CanvasTextures canvasTextures;
+// stroke painted while the left button is held down
+BrushStroke brushStroke;
+// copies of the tiles of image each stroke and fill changed, to undo them
+UndoHistory undoHistory( image );
 GLuint squareVAO, VBO, EBO;
 bool cursorIsHeldDown = false;
 bool cursorIsDisabled = false;
@@ -94,8 +105,16 @@ glm::vec2 clampedMousePos;
 static float framesPerSecond = 0.0f;
 static int fps;
 
-int main()
+int main( int argc, char **argv )
 {
+    int imageWidth = argc == 3 ? atoi( argv[1] ) : DEFAULT_IMAGE_WIDTH;
+    int imageHeight = argc == 3 ? atoi( argv[2] ) : DEFAULT_IMAGE_HEIGHT;
+    if (( argc != 1 && argc != 3 ) || imageWidth <= 0 || imageHeight <= 0 )
+    {
+        std::cout << "Usage: " << argv[0] << " [width height]" << std::endl;
+        return -1;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -133,9 +152,11 @@ int main()
         return -1;
     }
 
-    shader = new Shader( "shaders/painting.vert", "shaders/painting.frag" );
-    blurShader = new Shader( "shaders/painting.vert", "shaders/Blur.frag" );
-    gaussianShader = new Shader( "shaders/painting.vert", "shaders/Gaussian.frag" );
+    // the three of them read the canvas through canvasColor()
+    std::string canvasFunctions = CanvasTextures::shaderFunctions();
+    shader = new Shader( "shaders/painting.vert", "shaders/painting.frag", nullptr, canvasFunctions );
+    blurShader = new Shader( "shaders/painting.vert", "shaders/Blur.frag", nullptr, canvasFunctions );
+    gaussianShader = new Shader( "shaders/painting.vert", "shaders/Gaussian.frag", nullptr, canvasFunctions );
 
     // init plane
     setupPlane();
@@ -187,29 +208,26 @@ int main()
     // The framebuffer, which regroups 0, 1, or more textures, and 0 or 1 depth buffer.
 
 
-    // Initialize texture to be all white
-    for ( int i = 0; i < IMAGE_WIDTH; i++ )
+    if ( !CanvasTextures::fits( imageWidth, imageHeight ))
     {
-        for ( int j = 0; j < IMAGE_HEIGHT; j++ )
-        {
-
-            image[i][j][0] = 255;
-            image[i][j][1] = 255;
-            image[i][j][2] = 255;
-            image[i][j][3] = 255;
-        }
-
+        std::cout << "A canvas of " << imageWidth << "x" << imageHeight << " is too large for this GPU" << std::endl;
+        glfwTerminate();
+        return -1;
     }
-    // Setup texture
-    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
-    glGenTextures( 1, &canvas );
-    glBindTexture( GL_TEXTURE_2D, canvas );
-    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, IMAGE_WIDTH, IMAGE_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, image );
 
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
-    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    // Blank canvas, nothing is allocated for it until it is painted on
+    image.reset( imageWidth, imageHeight );
 
-    glBindTexture( GL_TEXTURE_2D, 0 );
+    // Setup textures
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+    canvasTextures.create( image );
+    for ( Shader *canvasShader : { shader, blurShader, gaussianShader } )
+    {
+        canvasShader->use();
+        canvasShader->setInt( "canvas", 0 );
+        canvasShader->setInt( "tiles", 1 );
+        canvasShader->setVec2( "canvasSize", (float) image.width(), (float) image.height());
+    }
 
 
     // render loop
@@ -225,6 +243,9 @@ int main()
         lastFrame = currentFrame;
         processInput( window );
 
+        // upload the tiles painted since the last frame, once for all the events of the frame
+        canvasTextures.upload( image );
+
         if ( config.blurType == 0 )
             shader->use();
         else if ( config.blurType == 1 )
@@ -233,10 +254,9 @@ int main()
             blurShader->use();
 
         glBindVertexArray( squareVAO );
-        glBindTexture( GL_TEXTURE_2D, canvas );
+        canvasTextures.bind();
         glDrawElements( GL_TRIANGLES, numberOfIndices, GL_UNSIGNED_INT, 0 );
         glBindVertexArray( 0 );
-        glBindTexture( GL_TEXTURE_2D, 0 );
 
         CalculateFrameRate( deltaTime, lastFrame );
         drawGui();
@@ -259,6 +279,7 @@ int main()
 
     // Cleanup
     // -------
+    canvasTextures.destroy();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -269,74 +290,14 @@ int main()
     return 0;
 }
 
-// queue data structure of vec2 for Flood Fill
-
-
-Queue *Q = new Queue( IMAGE_WIDTH * IMAGE_HEIGHT );
+// scanline flood fill, kept between fills so its seed stack is only allocated once
+FloodFiller floodFiller;
 
-Color GetImageColorFromUBytes( GLubyte r, GLubyte g, GLubyte b )
+// fills the area of the color of the pixel at (xPos, yPos) connected to it, returns the bounding box of the pixels
+// that changed
+Rect FloodFill( int xPos, int yPos, Color replacementColor )
 {
-    return Color( r, g, b );
-}
-
-
-void FloodFill( int xPos, int yPos, Color targetColor, Color replacementColor )
-{
-    // Only fill if inside the bounds
-    if ( xPos < 0 || xPos >= IMAGE_WIDTH || yPos < 0 || yPos >= IMAGE_HEIGHT )
-        return;
-
-    // Remove old queue
-    delete Q;
-
-    Q = new Queue( IMAGE_WIDTH * IMAGE_HEIGHT * 8 );
-    // queue current pixel and start filling
-    Q->enqueue( glm::vec2( yPos, xPos ));
-    while ( !Q->isEmpty())
-    {
-        // Remove first pixel and check if inside bound
-        glm::vec2 N = Q->dequeue();
-
-        if ( N.x < 0 || N.x >= IMAGE_WIDTH || N.y < 0 || N.y >= IMAGE_HEIGHT )
-            continue;
-
-        // Compare colors of current pixel and target color. If they are the same, fill the pixel with replacement color
-        int r = image[(int) N.x][(int) N.y][0];
-        int g = image[(int) N.x][(int) N.y][1];
-        int b = image[(int) N.x][(int) N.y][2];
-        Color imgColor = Color( r, g, b );
-
-        if ( imgColor == targetColor )
-        {
-            image[(int) N.x][(int) N.y][0] = replacementColor.r;
-            image[(int) N.x][(int) N.y][1] = replacementColor.g;
-            image[(int) N.x][(int) N.y][2] = replacementColor.b;
-            image[(int) N.x][(int) N.y][3] = 255;
-
-
-            auto right = image[(int) N.x + 1][(int) N.y];
-            auto left = image[(int) N.x - 1][(int) N.y];
-            auto up = image[(int) N.x][(int) N.y + 1];
-            auto down = image[(int) N.x][(int) N.y - 1];
-            // Get color values from neighboring pixels
-            Color rightColor = GetImageColorFromUBytes( right[0], right[1], right[2] );
-            Color leftColor = GetImageColorFromUBytes( left[0], left[1], left[2] );
-            Color upColor = GetImageColorFromUBytes( up[0], up[1], up[2] );
-            Color downColor = GetImageColorFromUBytes( down[0], down[1], down[2] );
-
-            // enqueue neighbours that have the same color as target color
-            if ( rightColor == targetColor )
-                Q->enqueue( glm::vec2( N.x + 1, N.y ));
-            if ( leftColor == targetColor )
-                Q->enqueue( glm::vec2( N.x - 1, N.y ));
-            if ( upColor == targetColor )
-                Q->enqueue( glm::vec2( N.x, N.y + 1 ));
-            if ( downColor == targetColor )
-                Q->enqueue( glm::vec2( N.x, N.y - 1 ));
-
-
-        }
-    }
+    return floodFiller.fill( image, xPos, yPos, replacementColor, &undoHistory );
 }
 
 
@@ -397,6 +358,16 @@ void drawGui()
         ImGui::ColorPicker3( "Brush color", config.brushColor );
         ImGui::EndGroup();
 
+        ImGui::Separator();
+        if ( ImGui::Button( "Undo" ) && !brushStroke.isActive())
+            undoHistory.undo();
+        ImGui::SameLine();
+        if ( ImGui::Button( "Redo" ) && !brushStroke.isActive())
+            undoHistory.redo();
+        ImGui::Text( "History: %.1f MB", undoHistory.memoryBytes() / ( 1024.0 * 1024.0 ));
+        ImGui::Text( "Canvas: %d x %d, %.1f MB (%.1f MB on the GPU)", image.width(), image.height(),
+                     image.memoryBytes() / ( 1024.0 * 1024.0 ), canvasTextures.gpuBytes() / ( 1024.0 * 1024.0 ));
+
         ImGui::End();
 
     }
@@ -432,51 +403,13 @@ void cursor_input_callback( GLFWwindow *window, double posX, double posY )
     posY = glm::clamp((float) posY, min, maxY - 1 );
 
     // Normalize values between 0 and image width/height
-    float x = ( IMAGE_WIDTH * (((float) ( posX ) - min ) / ((float) maxX - min )));
-    float y = ( IMAGE_HEIGHT * (( SCR_HEIGHT - (float) posY - min ) / ((float) maxY - min )));
+    float x = ( image.width() * (((float) ( posX ) - min ) / ((float) maxX - min )));
+    float y = ( image.height() * (( SCR_HEIGHT - (float) posY - min ) / ((float) maxY - min )));
     clampedMousePos = { x, y };
     if ( cursorIsHeldDown )
     {
-        float twoFifths = ( 1.0f / 5.0f ) * config.brushSize;
-        float threeFifths = ( 4.0f / 5.0f ) * config.brushSize;
-
-        int mouseY = clampedMousePos.y;
-        int mouseX = clampedMousePos.x;
-        int startY = (int) glm::clamp(( mouseY - ( config.brushSize / 2 )), 0, (int) IMAGE_HEIGHT );
-        int startX = (int) glm::clamp( mouseX + ( config.brushSize / 2 ), 0, (int) IMAGE_WIDTH );
-
-
-        // Draw "circle" shape
-        for ( int y = 0; y <= config.brushSize; y++ )
-        {
-            for ( int x = 0; x <= config.brushSize; x++ )
-            {
-                // Don't draw corners
-                if (
-                        x < twoFifths && y < twoFifths ||
-                        x >= threeFifths && y >= threeFifths ||
-                        x < twoFifths && y >= threeFifths ||
-                        x >= threeFifths && y < twoFifths
-                        )
-                {
-                    continue;
-                }
-                int actualY = (int) glm::clamp( startY + y, 0, (int) IMAGE_HEIGHT );
-                int actualx = (int) glm::clamp( startX - x, 0, (int) IMAGE_WIDTH );
-
-                image[(int) actualY][(int) actualx][0] = config.brushColor[0] * 255;
-                image[(int) actualY][(int) actualx][1] = config.brushColor[1] * 255;
-                image[(int) actualY][(int) actualx][2] = config.brushColor[2] * 255;
-                image[(int) actualY][(int) actualx][3] = 255;
-            }
-        }
-
-        // Update buffer with new image data
-        glBindTexture( GL_TEXTURE_2D, canvas );
-        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE,
-                         image );
-        glBindTexture( GL_TEXTURE_2D, 0 );
-
+        // stamp the brush all along the way from the last position, the changed tiles are uploaded with the next frame
+        brushStroke.lineTo( image, clampedMousePos );
     }
 
     lastX = (float) posX;
@@ -493,6 +426,14 @@ void key_input_callback( GLFWwindow *window, int button, int other, int action,
         glfwSetInputMode( window, GLFW_CURSOR, GLFW_CURSOR_NORMAL );
     }
 
+    // ctrl + z undoes, ctrl + y or ctrl + shift + z redoes. not in the middle of a stroke
+    if ( action == GLFW_PRESS && ( mods & GLFW_MOD_CONTROL ) && !brushStroke.isActive())
+    {
+        if ( button == GLFW_KEY_Z && !( mods & GLFW_MOD_SHIFT ))
+            undoHistory.undo();
+        else if ( button == GLFW_KEY_Y || button == GLFW_KEY_Z )
+            undoHistory.redo();
+    }
 }
 
 void mouse_button_callback( GLFWwindow *window, int button, int action, int mods )
@@ -500,13 +441,17 @@ void mouse_button_callback( GLFWwindow *window, int button, int action, int mods
     if ( button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && !cursorIsDisabled )
     {
         cursorIsHeldDown = true;
-        double xpos, ypos;
-        //getting cursor position
-        glfwGetCursorPos( window, &xpos, &ypos );
+        undoHistory.begin();
+        Color strokeColor = { static_cast<GLubyte>(config.brushColor[0] * 255.f),
+                              static_cast<GLubyte>(config.brushColor[1] * 255.f),
+                              static_cast<GLubyte>(config.brushColor[2] * 255.f) };
+        brushStroke.begin( image, clampedMousePos, config.brushSize, strokeColor, &undoHistory );
 
     } else if ( button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_RELEASE )
     {
         cursorIsHeldDown = false;
+        brushStroke.end();
+        undoHistory.end();
     }
     // Flood fill
     if ( button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS )
@@ -516,9 +461,8 @@ void mouse_button_callback( GLFWwindow *window, int button, int action, int mods
                                    static_cast<GLubyte>(config.brushColor[1] * 255.f),
                                    static_cast<GLubyte>(config.brushColor[2] * 255.f) };
 
-        Color targetColor = { image[(int) clampedMousePos.y][(int) clampedMousePos.x][0],
-                              image[(int) clampedMousePos.y][(int) clampedMousePos.x][1],
-                              image[(int) clampedMousePos.y][(int) clampedMousePos.x][2] };
+        const GLubyte *target = image.row((int) clampedMousePos.x, (int) clampedMousePos.y );
+        Color targetColor = { target[0], target[1], target[2] };
 
         std::cout << "Flood filling at: " << (int) clampedMousePos.x << ", " << (int) clampedMousePos.y
                   << " replacement color: " << std::to_string( replacementColor.r ) << ", "
@@ -531,13 +475,10 @@ void mouse_button_callback( GLFWwindow *window, int button, int action, int mods
         if ( targetColor == replacementColor )
             return;
 
-        FloodFill( clampedMousePos.x, clampedMousePos.y, targetColor, replacementColor );
-
-        // Update the texture
-        glBindTexture( GL_TEXTURE_2D, canvas );
-        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE,
-                         image );
-        glBindTexture( GL_TEXTURE_2D, 0 );
+        undoHistory.begin();
+        // the filled tiles are uploaded with the next frame
+        FloodFill( clampedMousePos.x, clampedMousePos.y, replacementColor );
+        undoHistory.end();
     }
 }
 
@@ -15,9 +15,11 @@ class Shader
 public:
     unsigned int ID;
 
-    // constructor generates the shader on the fly
+    // constructor generates the shader on the fly. fragmentHeader, if given, is inserted in the fragment shader after
+    // its #version line, for code shared by several shaders
     // ------------------------------------------------------------------------
-    Shader( const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr )
+    Shader( const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr,
+            const std::string &fragmentHeader = "" )
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
@@ -45,6 +47,12 @@ public:
             // convert stream into string
             vertexCode = vShaderStream.str();
             fragmentCode = fShaderStream.str();
+            if ( !fragmentHeader.empty())
+            {
+                // #line keeps the line numbers of the compile errors those of the file
+                size_t afterVersion = fragmentCode.find( '\n' ) + 1;
+                fragmentCode.insert( afterVersion, fragmentHeader + "#line 2\n" );
+            }
             // if geometry shader path is present, also load a geometry shader
             if ( geometryPath != nullptr )
             {
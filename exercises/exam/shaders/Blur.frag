@@ -1,11 +1,12 @@
 #version 330
 layout(location = 0) out vec4 color;
 
-uniform sampler2D canvas;
+// canvas, canvasSize and canvasColor() come from CanvasTextures::shaderFunctions()
 in vec2 UV;
 const int neighbourMultiplier = 2;
 
 void main() {
+    // one pixel of the window (SCR_WIDTH x SCR_HEIGHT in main.cpp), the canvas is drawn over all of it
     vec2 cellSize = 1.0 / vec2(720, 720);
     // Get neighbour UVs
     vec2 neighbourUVs[4];
@@ -16,13 +17,13 @@ void main() {
 
     // get neighbour colors
     vec4 neighbourColors[4];
-    neighbourColors[0] = texture(canvas, neighbourUVs[0]);
-    neighbourColors[1] = texture(canvas, neighbourUVs[1]);
-    neighbourColors[2] = texture(canvas, neighbourUVs[2]);
-    neighbourColors[3] = texture(canvas, neighbourUVs[3]);
+    neighbourColors[0] = canvasColor(neighbourUVs[0]);
+    neighbourColors[1] = canvasColor(neighbourUVs[1]);
+    neighbourColors[2] = canvasColor(neighbourUVs[2]);
+    neighbourColors[3] = canvasColor(neighbourUVs[3]);
 
     // get average color
-    vec4 averageColor = texture(canvas, UV);
+    vec4 averageColor = canvasColor(UV);
     for (int i = 0; i < 4; i++)
     {
         averageColor += neighbourColors[i];
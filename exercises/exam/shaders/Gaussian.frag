@@ -1,22 +1,23 @@
 #version 330 core
 layout(location = 0) out vec4 color;
 
-uniform sampler2D canvas;
+// canvas, canvasSize and canvasColor() come from CanvasTextures::shaderFunctions()
 in vec2 UV;
 // reference: https://en.wikipedia.org/wiki/Kernel_(image_processing)
 void main()
 {
-    float offset = 1.0 / 1920;
+    // one pixel of the canvas
+    vec2 offset = 1.0 / canvasSize;
     vec2 offsets[9] = vec2[](
-    vec2(-offset, offset), // top-left
-    vec2(0.0f, offset), // top-center
-    vec2(offset, offset), // top-right
-    vec2(-offset, 0.0f), // center-left
+    vec2(-offset.x, offset.y), // top-left
+    vec2(0.0f, offset.y), // top-center
+    vec2(offset.x, offset.y), // top-right
+    vec2(-offset.x, 0.0f), // center-left
     vec2(0.0f, 0.0f), // center-center
-    vec2(offset, 0.0f), // center-right
-    vec2(-offset, -offset), // bottom-left
-    vec2(0.0f, -offset), // bottom-center
-    vec2(offset, -offset)// bottom-right
+    vec2(offset.x, 0.0f), // center-right
+    vec2(-offset.x, -offset.y), // bottom-left
+    vec2(0.0f, -offset.y), // bottom-center
+    vec2(offset.x, -offset.y)// bottom-right
     );
 
     // Gausian blur
@@ -29,7 +30,7 @@ void main()
     vec3 sampleTex[9];
     for (int i = 0; i < 9; i++)
     {
-        sampleTex[i] = vec3(texture(canvas, UV.st + offsets[i]));
+        sampleTex[i] = vec3(canvasColor(UV.st + offsets[i]));
     }
     vec3 col = vec3(0.0);
     for (int i = 0; i < 9; i++)
@@ -1,11 +1,11 @@
 #version 330 core
 layout(location = 0) out vec4 color;
 
-uniform sampler2D canvas;
+// canvas, canvasSize and canvasColor() come from CanvasTextures::shaderFunctions()
 in vec2 UV;
 
 void main()
 {
-    color = texture(canvas, UV);
+    color = canvasColor(UV);
 }
 
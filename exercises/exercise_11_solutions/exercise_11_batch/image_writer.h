@@ -0,0 +1,135 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_IMAGE_WRITER_H
+#define ITU_GRAPHICS_PROGRAMMING_IMAGE_WRITER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "frame_buffer.h"
+
+// writes the color buffer of the ray tracer (RGBA, 8 bits per channel, packed in a uint32_t, see rt::Colors::toRGBA32)
+// to image files. row 0 of the buffer is the bottom of the image, like in the OpenGL texture it is normally uploaded
+// to, image files start at the top so the rows are flipped. alpha is dropped
+namespace ImageWriter {
+
+    // RGB bytes of the image, top row first
+    inline std::vector<uint8_t> toRGB(const FrameBuffer<uint32_t> &fb) {
+        std::vector<uint8_t> rgb(fb.W * fb.H * 3);
+        uint8_t *out = rgb.data();
+        for (unsigned int r = fb.H; r-- > 0;) {
+            for (unsigned int c = 0; c < fb.W; c++) {
+                uint32_t pixel = fb.valueAt(c, r);
+                *out++ = uint8_t(pixel);
+                *out++ = uint8_t(pixel >> 8);
+                *out++ = uint8_t(pixel >> 16);
+            }
+        }
+        return rgb;
+    }
+
+    // binary portable pixmap (P6), the simplest format any image viewer reads
+    inline bool writePPM(const char *path, const FrameBuffer<uint32_t> &fb) {
+        FILE *file = fopen(path, "wb");
+        if (file == NULL) return false;
+        std::vector<uint8_t> rgb = toRGB(fb);
+        fprintf(file, "P6\n%u %u\n255\n", fb.W, fb.H);
+        bool ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    namespace detail {
+        inline uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+            static uint32_t table[256] = {0};
+            if (table[1] == 0) {
+                for (uint32_t n = 0; n < 256; n++) {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    table[n] = c;
+                }
+            }
+            crc = ~crc;
+            for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        inline void putBigEndian(std::vector<uint8_t> &out, uint32_t value) {
+            out.push_back(uint8_t(value >> 24));
+            out.push_back(uint8_t(value >> 16));
+            out.push_back(uint8_t(value >> 8));
+            out.push_back(uint8_t(value));
+        }
+
+        // a chunk is its length, its type, the data and the crc of type and data
+        inline void putChunk(std::vector<uint8_t> &png, const char *type, const std::vector<uint8_t> &data) {
+            putBigEndian(png, (uint32_t) data.size());
+            size_t typeStart = png.size();
+            png.insert(png.end(), type, type + 4);
+            png.insert(png.end(), data.begin(), data.end());
+            putBigEndian(png, crc32(&png[typeStart], png.size() - typeStart));
+        }
+    }
+
+    // PNG, RGB 8 bits per channel. the image is stored in uncompressed deflate blocks, so files are about as large as
+    // PPMs, but we don't need zlib and every viewer (and browser) can open them
+    inline bool writePNG(const char *path, const FrameBuffer<uint32_t> &fb) {
+        std::vector<uint8_t> rgb = toRGB(fb);
+
+        // each row starts with its filter type, 0 is none
+        size_t rowSize = fb.W * 3;
+        std::vector<uint8_t> raw;
+        raw.reserve((rowSize + 1) * fb.H);
+        for (unsigned int r = 0; r < fb.H; r++) {
+            raw.push_back(0);
+            raw.insert(raw.end(), rgb.begin() + r * rowSize, rgb.begin() + (r + 1) * rowSize);
+        }
+
+        // zlib stream: header, stored blocks of at most 65535 bytes, adler32 of the uncompressed data
+        std::vector<uint8_t> zlib = {0x78, 0x01};
+        size_t maxBlock = 65535;
+        for (size_t start = 0; ; start += maxBlock) {
+            size_t size = std::min(maxBlock, raw.size() - start);
+            bool last = start + size == raw.size();
+            zlib.push_back(last ? 1 : 0);
+            zlib.push_back(uint8_t(size));
+            zlib.push_back(uint8_t(size >> 8));
+            zlib.push_back(uint8_t(~size));
+            zlib.push_back(uint8_t(~size >> 8));
+            zlib.insert(zlib.end(), raw.begin() + start, raw.begin() + start + size);
+            if (last) break;
+        }
+        uint32_t a = 1, b = 0;
+        for (uint8_t byte : raw) {
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+        }
+        detail::putBigEndian(zlib, (b << 16) | a);
+
+        std::vector<uint8_t> header;
+        detail::putBigEndian(header, fb.W);
+        detail::putBigEndian(header, fb.H);
+        // bit depth 8, color type 2 (RGB), default compression, filter and no interlacing
+        header.insert(header.end(), {8, 2, 0, 0, 0});
+
+        std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        detail::putChunk(png, "IHDR", header);
+        detail::putChunk(png, "IDAT", zlib);
+        detail::putChunk(png, "IEND", std::vector<uint8_t>());
+
+        FILE *file = fopen(path, "wb");
+        if (file == NULL) return false;
+        bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+        return fclose(file) == 0 && ok;
+    }
+
+    // picks the format from the extension of the path, .ppm or .png (the default)
+    inline bool write(const std::string &path, const FrameBuffer<uint32_t> &fb) {
+        size_t dot = path.find_last_of('.');
+        std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+        if (extension == ".ppm" || extension == ".PPM") return writePPM(path.c_str(), fb);
+        return writePNG(path.c_str(), fb);
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_IMAGE_WRITER_H
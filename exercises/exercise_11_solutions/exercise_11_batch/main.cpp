@@ -0,0 +1,303 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/constants.hpp>
+#include "rt_renderer.h"
+#include "primitives.h"
+#include "objloader.h"
+#include "image_writer.h"
+
+// renders frames of the exercise 11 scene without a window (and without OpenGL), and writes them to image files
+//
+// usage: exercise_11_batch [options]
+//   --obj path        model to put in the room, in place of the small cube (the model is scaled to fit a unit sphere)
+//   --size WxH        image resolution, default 256x256
+//   --depth n         1 is no reflections, 2 one reflection and so on, default 2
+//   --fov degrees     vertical field of view, default 70
+//   --threads n       render threads, 0 (the default) uses every core
+//   --camera ex,ey,ez,tx,ty,tz
+//                     camera position and target of a single frame, default the starting view of exercise_11_sol
+//   --frames path     list of frames, one camera per line, given by the 6 numbers above (separated by spaces or
+//                     commas), empty lines and lines starting with # are skipped
+//   --orbit n         n frames that go around the room
+//   --out pattern     printf pattern of the image names, with one %d for the frame number (%04d for zero padding),
+//                     default frame_%04d.png, .ppm writes portable pixmaps
+//   --aa n            adaptive anti-aliasing, n x n samples in the pixels that differ from their neighbours, default
+//                     off
+//   --color mode      linear (the default, same colors as the window), srgb, dithered or srgb-dithered
+//
+// each frame prints its render time and rays per second, the last line is the total for every frame
+
+struct Frame {
+    glm::vec3 eye;
+    glm::vec3 target;
+};
+
+struct Options {
+    std::string obj;
+    unsigned int width = 256, height = 256;
+    unsigned int depth = 2;
+    float fov = 70.0f;
+    unsigned int threads = 0;
+    std::vector<Frame> frames;
+    std::string out = "frame_%04d.png";
+    unsigned int aa = 0;
+    rt::Colors::Conversion color;
+};
+
+void printUsage() {
+    printf("usage: exercise_11_batch [--obj path] [--size WxH] [--depth n] [--fov degrees] [--threads n]\n"
+           "                         [--camera ex,ey,ez,tx,ty,tz | --frames path | --orbit n] [--out pattern]\n"
+           "                         [--aa n] [--color linear|srgb|dithered|srgb-dithered]\n");
+}
+
+bool parseFrame(std::string line, Frame &frame) {
+    for (char &ch : line) if (ch == ',') ch = ' ';
+    std::istringstream in(line);
+    return (bool) (in >> frame.eye.x >> frame.eye.y >> frame.eye.z >> frame.target.x >> frame.target.y >> frame.target.z);
+}
+
+bool loadFrames(const char *path, std::vector<Frame> &frames) {
+    std::ifstream file(path);
+    if (!file) {
+        printf("can't open the frame list %s\n", path);
+        return false;
+    }
+    std::string line;
+    for (unsigned int lineNumber = 1; std::getline(file, line); lineNumber++) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') continue;
+        Frame frame;
+        if (!parseFrame(line, frame)) {
+            printf("%s:%u: expected ex ey ez tx ty tz\n", path, lineNumber);
+            return false;
+        }
+        frames.push_back(frame);
+    }
+    return true;
+}
+
+// the --out pattern is given to snprintf with the frame number, so it must have exactly one %d (with an optional zero
+// padded width, like %04d) and nothing else snprintf would read an argument for. %% is allowed
+bool isFramePattern(const std::string &pattern) {
+    unsigned int conversions = 0;
+    for (size_t i = 0; i < pattern.size(); i++) {
+        if (pattern[i] != '%') continue;
+        if (++i < pattern.size() && pattern[i] == '%') continue;
+        while (i < pattern.size() && isdigit((unsigned char) pattern[i])) i++;
+        if (i >= pattern.size() || pattern[i] != 'd') return false;
+        conversions++;
+    }
+    return conversions == 1;
+}
+
+// reads the decimal number text starts with and moves text past it, it must be between lo and hi (no sign allowed)
+bool parseNumber(const char *&text, long lo, long hi, unsigned int &value) {
+    if (!isdigit((unsigned char) text[0])) return false;
+    errno = 0;
+    char *end;
+    long number = strtol(text, &end, 10);
+    if (errno == ERANGE || number < lo || number > hi) return false;
+    text = end;
+    value = (unsigned int) number;
+    return true;
+}
+
+// a number given as the whole value of an option
+bool parseValue(const char *value, long lo, long hi, unsigned int &result) {
+    return parseNumber(value, lo, hi, result) && *value == '\0';
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            printf("missing value for %s\n", arg.c_str());
+            return false;
+        }
+        const char *value = argv[++i];
+        if (arg == "--obj") options.obj = value;
+        else if (arg == "--size") {
+            if (!parseNumber(value, 1, 16384, options.width) || *value++ != 'x' ||
+                !parseValue(value, 1, 16384, options.height)) {
+                printf("--size expects WxH up to 16384x16384, e.g. 640x480\n");
+                return false;
+            }
+        }
+        else if (arg == "--depth") {
+            if (!parseValue(value, 1, 64, options.depth)) {
+                printf("--depth expects a number from 1 to 64\n");
+                return false;
+            }
+        }
+        else if (arg == "--fov") options.fov = (float) atof(value);
+        else if (arg == "--threads") {
+            if (!parseValue(value, 0, 1024, options.threads)) {
+                printf("--threads expects a number from 0 to 1024\n");
+                return false;
+            }
+        }
+        else if (arg == "--camera") {
+            Frame frame;
+            if (!parseFrame(value, frame)) {
+                printf("--camera expects ex,ey,ez,tx,ty,tz\n");
+                return false;
+            }
+            options.frames.push_back(frame);
+        }
+        else if (arg == "--frames") {
+            if (!loadFrames(value, options.frames)) return false;
+        }
+        else if (arg == "--orbit") {
+            unsigned int count;
+            if (!parseValue(value, 1, 100000, count)) {
+                printf("--orbit expects a number of frames from 1 to 100000\n");
+                return false;
+            }
+            for (unsigned int f = 0; f < count; f++) {
+                float angle = glm::two_pi<float>() * f / count;
+                options.frames.push_back(Frame{glm::vec3(1.75f * sin(angle), .3f, 1.75f * cos(angle)), glm::vec3(0)});
+            }
+        }
+        else if (arg == "--out") {
+            if (!isFramePattern(value)) {
+                printf("--out expects a file name with one %%d for the frame number, e.g. frame_%%04d.png\n");
+                return false;
+            }
+            options.out = value;
+        }
+        else if (arg == "--aa") {
+            if (!parseValue(value, 0, 16, options.aa)) {
+                printf("--aa expects a number from 0 to 16\n");
+                return false;
+            }
+        }
+        else if (arg == "--color") {
+            std::string mode = value;
+            if (mode != "linear" && mode != "srgb" && mode != "dithered" && mode != "srgb-dithered") {
+                printf("--color expects linear, srgb, dithered or srgb-dithered\n");
+                return false;
+            }
+            options.color.srgb = mode == "srgb" || mode == "srgb-dithered";
+            options.color.dither = mode == "dithered" || mode == "srgb-dithered";
+        }
+        else {
+            printf("unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    // the view exercise_11_sol starts with
+    if (options.frames.empty())
+        options.frames.push_back(Frame{glm::vec3(0.9f, 0.0f, 1.5f), glm::vec3(0.9f, 0.0f, 0.5f)});
+    return true;
+}
+
+// the scene of exercise_11_sol: a small colored cube, or the model, inside a grey room the camera can't leave
+bool makeScene(const std::string &obj, std::vector<rt::vertex> &vts) {
+    std::vector<glm::vec3> points;
+    std::vector<glm::vec4> colors;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    Primitives::makeCube(2.f, points, normals, uvs, colors);
+
+    if (obj.empty()) {
+        glm::mat4 scale = glm::scale(glm::vec3(.25f, .25f, .25f));
+        for (unsigned int i = 0; i < points.size(); i++)
+            vts.push_back(rt::vertex{scale * glm::vec4(points[i], 1.0f), glm::vec4(normals[i], 0), colors[i], uvs[i]});
+    } else {
+        std::vector<glm::vec3> modelPoints, modelNormals;
+        std::vector<glm::vec2> modelUvs;
+        if (!loadOBJ(obj.c_str(), modelPoints, modelUvs, modelNormals) || modelPoints.empty()) return false;
+
+        // center the model at the origin and scale it to fit a unit sphere, like the cube
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+        for (const glm::vec3 &p : modelPoints) {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        float radius = glm::length(hi - lo) * .5f;
+        glm::mat4 fit = glm::scale(glm::vec3(radius > 0 ? 1.0f / radius : 1.0f)) * glm::translate(-(lo + hi) * .5f);
+        for (unsigned int i = 0; i < modelPoints.size(); i++)
+            vts.push_back(rt::vertex{fit * glm::vec4(modelPoints[i], 1.0f), glm::vec4(modelNormals[i], 0),
+                                     rt::white, modelUvs[i]});
+    }
+
+    glm::mat4 outsideout = glm::scale(glm::vec3(-2.f, -2.f, -2.f));
+    for (unsigned int i = 0; i < points.size(); i++)
+        vts.push_back(rt::vertex{outsideout * glm::vec4(points[i], 1.0f), glm::vec4(normals[i], 0), rt::grey, uvs[i]});
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<rt::vertex> vts;
+    if (!makeScene(options.obj, vts)) {
+        printf("can't load %s\n", options.obj.c_str());
+        return 1;
+    }
+
+    // same setup as the window of exercise_11_sol
+    rt::Renderer renderer;
+    rt::BVH bvh;
+    bvh.build(vts);
+    printf("BVH built over %u triangles: %u nodes in %.2f ms\n",
+           bvh.primitiveCount(), (unsigned int) bvh.nodes.size(), bvh.buildTimeMs);
+    renderer.setAccelerationStructure(&bvh);
+    std::vector<rt::triangle> compactTriangles = rt::makeTriangles(vts);
+    renderer.setCompactTriangles(&compactTriangles);
+    rt::TriangleSoA packetTriangles(vts);
+    renderer.setPacketTriangles(&packetTriangles);
+    renderer.setThreadCount(options.threads);
+    renderer.setColorConversion(options.color);
+    renderer.setAdaptiveSampling(options.aa);
+
+    FrameBuffer<uint32_t> fb(options.width, options.height);
+    double totalSeconds = 0;
+    unsigned long long totalRays = 0;
+
+    for (unsigned int f = 0; f < options.frames.size(); f++) {
+        const Frame &frame = options.frames[f];
+        glm::mat4 view = glm::lookAt(frame.eye, frame.target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+        fb.clearBuffer(rt::Colors::toRGBA32(rt::Colors::black));
+        auto start = std::chrono::high_resolution_clock::now();
+        renderer.render(vts, glm::mat4(1), view, options.fov, options.depth, fb);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        totalSeconds += elapsed.count();
+        totalRays += renderer.stats.total();
+
+        char name[1024];
+        snprintf(name, sizeof(name), options.out.c_str(), (int) f);
+        bool written = ImageWriter::write(name, fb);
+
+        printf("frame %4u %9.2f ms %8.3f Mrays/s (primary %llu, shadow %llu, secondary %llu) %s %s\n", f,
+               elapsed.count() * 1000.0, renderer.stats.total() / elapsed.count() * 1e-6,
+               (unsigned long long) renderer.stats.primary, (unsigned long long) renderer.stats.shadow,
+               (unsigned long long) renderer.stats.secondary, written ? "->" : "could not write", name);
+#ifdef RT_ENABLE_COUNTERS
+        printf("           %s\n", renderer.stats.describeCounters().c_str());
+#endif
+        if (!written) return 1;
+    }
+
+    printf("%u frames of %ux%u in %.2f ms, %.2f ms per frame, %.3f Mrays/s\n", (unsigned int) options.frames.size(),
+           options.width, options.height, totalSeconds * 1000.0, totalSeconds * 1000.0 / options.frames.size(),
+           totalRays / totalSeconds * 1e-6);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_BENCH_INSTANCES_H
+#define ITU_GRAPHICS_PROGRAMMING_BENCH_INSTANCES_H
+
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+#include <glm/gtx/transform.hpp>
+#include "rt_renderer.h"
+#include "scenes.h"
+
+// compares a grid of spheres placed as instances of one mesh in an rt::Scene with the same spheres copied into a
+// single vertex list: memory used by the geometry and the hierarchies, and time to render a frame
+namespace InstanceComparison {
+
+    inline size_t flatBytes(const std::vector<rt::vertex> &vts, const std::vector<rt::triangle> &tris, const rt::BVH &bvh) {
+        return vts.size() * sizeof(rt::vertex) + tris.size() * sizeof(rt::triangle) +
+               bvh.nodes.size() * sizeof(rt::BVHNode) + bvh.indices.size() * sizeof(unsigned int);
+    }
+
+    // fastest of a few frames, in milliseconds
+    template<class Render>
+    double frameMs(Render render) {
+        double best = -1;
+        for (int frame = 0; frame < 3; frame++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            render();
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            if (best < 0 || elapsed.count() < best) best = elapsed.count();
+        }
+        return best;
+    }
+
+    // side x side spheres of the given number of stacks in front of the camera, in the room
+    inline void run(unsigned int side, unsigned int stacks, unsigned int resolution, unsigned int depth, unsigned int threads) {
+        std::vector<rt::vertex> room;
+        BenchScenes::addRoom(room);
+        std::vector<rt::vertex> sphere = BenchScenes::sphere(stacks);
+        sphere.resize(sphere.size() - room.size()); // without the room sphere() adds
+
+        rt::Scene scene;
+        scene.addInstance(scene.addMesh(room), glm::mat4(1));
+        unsigned int sphereMesh = scene.addMesh(sphere);
+        std::vector<rt::vertex> flat = room;
+
+        float spacing = 1.6f / side;
+        for (unsigned int i = 0; i < side; i++) {
+            for (unsigned int j = 0; j < side; j++) {
+                glm::vec3 center((i + .5f) * spacing - .8f, (j + .5f) * spacing - .8f, -.5f);
+                glm::mat4 m = glm::translate(center) * glm::scale(glm::vec3(spacing * .8f));
+                scene.addInstance(sphereMesh, m);
+
+                glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(m)));
+                for (rt::vertex v : sphere) {
+                    v.pos = m * v.pos;
+                    v.norm = glm::vec4(glm::normalize(normalMatrix * glm::vec3(v.norm)), 0);
+                    flat.push_back(v);
+                }
+            }
+        }
+        scene.build();
+
+        rt::BVH bvh;
+        bvh.build(flat);
+        std::vector<rt::triangle> tris = rt::makeTriangles(flat);
+
+        rt::Renderer renderer;
+        renderer.setThreadCount(threads);
+        FrameBuffer<uint32_t> fb(resolution, resolution);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.9f, 0.0f, 1.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        double sceneMs = frameMs([&]() { renderer.render(scene, view, 70.0f, depth, fb); });
+        renderer.setAccelerationStructure(&bvh);
+        renderer.setCompactTriangles(&tris);
+        double flatMs = frameMs([&]() { renderer.render(flat, glm::mat4(1), view, 70.0f, depth, fb); });
+
+        printf("%u instances of a %u triangle sphere, %zu triangles in total, %ux%u depth %u\n", side * side,
+               (unsigned int) sphere.size() / 3, scene.triangleCount(), resolution, resolution, depth);
+        printf("%-12s %10.1f KB %8.2f ms per frame\n", "instanced", scene.memoryBytes() / 1024.0, sceneMs);
+        printf("%-12s %10.1f KB %8.2f ms per frame\n", "flat", flatBytes(flat, tris, bvh) / 1024.0, flatMs);
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_BENCH_INSTANCES_H
@@ -0,0 +1,97 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_BENCH_LAYOUTS_H
+#define ITU_GRAPHICS_PROGRAMMING_BENCH_LAYOUTS_H
+
+#include <vector>
+#include <chrono>
+#include <cstdio>
+
+#include <glm/gtx/transform.hpp>
+#include "rt_renderer.h"
+#include "perf_counters.h"
+
+// compares the closest hit queries of the ray tracer when the triangles are read from the vertex list (56 bytes per
+// vertex, 168 per triangle) and when they are read from the compact intersection-only copy (48 bytes per triangle)
+namespace LayoutComparison {
+
+    struct Layout {
+        const char *name;
+        bool compact;
+        bool useBVH;
+    };
+
+    inline void run(const std::vector<rt::vertex> &vts, unsigned int resolution) {
+        std::vector<rt::triangle> tris = rt::makeTriangles(vts);
+        rt::BVH bvh;
+        bvh.build(vts);
+
+        // the rays we test: the primary rays of an image and, for the ones that hit something, a shadow ray to the light
+        FrameBuffer<uint32_t> fb(resolution, resolution);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.9f, 0.0f, 1.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        rt::ImagePlane plane(glm::mat4(1), view, 70.0f, fb);
+        glm::vec3 light_pos(0, 1.9f, 0);
+
+        rt::Renderer renderer;
+        renderer.setAccelerationStructure(&bvh);
+        renderer.setCompactTriangles(&tris);
+        std::vector<rt::Ray> rays;
+        for (unsigned int c = 0; c < fb.W; c++) {
+            for (unsigned int r = 0; r < fb.H; r++) {
+                rt::Ray ray = plane.rayThrough(c, r);
+                rays.push_back(ray);
+                rt::Hit hit;
+                if (renderer.closestHit(ray, vts, hit)) {
+                    glm::vec3 p = ray.origin + ray.direction * hit.dist;
+                    rays.emplace_back(p - ray.direction * .001f, glm::normalize(light_pos - p));
+                }
+            }
+        }
+
+        printf("%u triangles, %zu rays (primary + shadow), %zu bytes per triangle in the vertex list, %zu compact\n",
+               (unsigned int) tris.size(), rays.size(), 3 * sizeof(rt::vertex), sizeof(rt::triangle));
+
+        std::vector<Layout> layouts = {{"vertex list, bvh", false, true}, {"compact, bvh", true, true}};
+        // testing every triangle is only bearable for small scenes
+        if (tris.size() <= 20000) {
+            layouts.push_back({"vertex list, brute force", false, false});
+            layouts.push_back({"compact, brute force", true, false});
+        }
+
+        CacheMissCounter counter;
+        if (!counter.available())
+            printf("hardware cache counters are not available, cache misses are reported as 0\n");
+
+        double referenceChecksum = -1;
+        for (const Layout &layout : layouts) {
+            renderer.setCompactTriangles(layout.compact ? &tris : nullptr);
+            renderer.setAccelerationStructure(layout.useBVH ? &bvh : nullptr);
+
+            // repeat until we have measured for long enough to trust the timer
+            double checksum = 0;
+            size_t traced = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed(0);
+            counter.start();
+            do {
+                checksum = 0;
+                for (const rt::Ray &ray : rays) {
+                    rt::Hit hit;
+                    if (renderer.closestHit(ray, vts, hit)) checksum += hit.dist;
+                }
+                traced += rays.size();
+                elapsed = std::chrono::high_resolution_clock::now() - start;
+            } while (elapsed.count() < 0.5);
+            counter.stop();
+
+            // every layout must find the same hits (we compare distances, a ray that hits an edge shared by two
+            // triangles can report either of them depending on the order in which they are tested)
+            if (referenceChecksum < 0) referenceChecksum = checksum;
+            if (checksum != referenceChecksum)
+                printf("warning: %s found different hits than %s\n", layout.name, layouts[0].name);
+
+            printf("%-26s %8.3f Mrays/s   L1d misses/ray %7.2f   LLC misses/ray %7.3f\n", layout.name,
+                   traced / elapsed.count() * 1e-6, double(counter.l1Misses) / traced, double(counter.llcMisses) / traced);
+        }
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_BENCH_LAYOUTS_H
@@ -0,0 +1,89 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <cstdio>
+
+#include "scenes.h"
+#include "suite.h"
+#include "layouts.h"
+#include "instances.h"
+
+// benchmarks of the CPU ray tracer of exercise_11_sol
+//
+// usage: exercise_11_bench [--obj path] [--json path] [--label text] [--threads n]
+//        exercise_11_bench --layouts
+//        exercise_11_bench --instances n [--threads n]
+//
+// the first form renders the cube of exercise 11, a tessellated sphere and, if one is given, a large model, all at
+// 256x256 with depth 3, and reports the rays per second of primary, shadow and reflected rays, the triangle tests
+// each of them needs and how many of them hit. results are printed and written as JSON to --json (default
+// exercise_11_bench.json) with the given label, e.g. the commit that was measured, so that runs on different commits
+// can be compared.
+// render threads default to 1, which gives the most repeatable numbers.
+//
+// the second form compares the vertex list and the compact triangles as the source of the intersection tests
+//
+// the third form renders n x n spheres as instances of one mesh and as copies in one vertex list, and compares their
+// memory and frame time
+
+const unsigned int resolution = 256;
+const unsigned int depth = 3;
+const unsigned int sphere_stacks = 200;
+
+int main(int argc, char **argv) {
+    std::string obj, json = "exercise_11_bench.json", label;
+    unsigned int threads = 1;
+    bool layouts = false;
+    unsigned int instances = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--layouts") layouts = true;
+        else if (i + 1 < argc && arg == "--instances") instances = (unsigned int) atoi(argv[++i]);
+        else if (i + 1 < argc && arg == "--obj") obj = argv[++i];
+        else if (i + 1 < argc && arg == "--json") json = argv[++i];
+        else if (i + 1 < argc && arg == "--label") label = argv[++i];
+        else if (i + 1 < argc && arg == "--threads") threads = (unsigned int) atoi(argv[++i]);
+        else {
+            printf("usage: exercise_11_bench [--obj path] [--json path] [--label text] [--threads n]\n"
+                   "       exercise_11_bench --layouts\n"
+                   "       exercise_11_bench --instances n [--threads n]\n");
+            return 1;
+        }
+    }
+
+    if (layouts) {
+        LayoutComparison::run(BenchScenes::sphere(sphere_stacks), resolution);
+        return 0;
+    }
+    if (instances > 0) {
+        InstanceComparison::run(instances, sphere_stacks / 4, resolution, depth, threads);
+        return 0;
+    }
+
+    std::vector<BenchSuite::SceneResult> results;
+    results.push_back(BenchSuite::run("cube", BenchScenes::cube(), resolution, depth, threads));
+    BenchSuite::print(results.back());
+    results.push_back(BenchSuite::run("sphere", BenchScenes::sphere(sphere_stacks), resolution, depth, threads));
+    BenchSuite::print(results.back());
+
+    if (!obj.empty()) {
+        std::vector<rt::vertex> vts;
+        if (!BenchScenes::obj(obj, vts)) {
+            printf("can't load %s\n", obj.c_str());
+            return 1;
+        }
+        results.push_back(BenchSuite::run("obj", vts, resolution, depth, threads));
+        BenchSuite::print(results.back());
+    } else {
+        printf("no --obj given, skipping the large model\n");
+    }
+
+    if (!BenchSuite::writeJSON(json.c_str(), label, results)) {
+        printf("can't write %s\n", json.c_str());
+        return 1;
+    }
+    printf("results written to %s\n", json.c_str());
+    return 0;
+}
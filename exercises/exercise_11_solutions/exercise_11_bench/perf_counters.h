@@ -0,0 +1,85 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_PERF_COUNTERS_H
+#define ITU_GRAPHICS_PROGRAMMING_PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// reads hardware cache miss counters of the calling thread through linux perf events.
+// on other systems, or when the kernel does not allow it (see /proc/sys/kernel/perf_event_paranoid, and virtual
+// machines often don't expose the counters), available() is false and all counts are 0
+class CacheMissCounter {
+    int l1Fd = -1;   // L1 data cache read misses
+    int llcFd = -1;  // last level cache misses
+
+#ifdef __linux__
+    static int open(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+
+    static uint64_t read(int fd) {
+        uint64_t value = 0;
+        if (fd < 0 || ::read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+        return value;
+    }
+#endif
+
+public:
+    uint64_t l1Misses = 0;
+    uint64_t llcMisses = 0;
+
+    CacheMissCounter() {
+#ifdef __linux__
+        l1Fd = open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        llcFd = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif
+    }
+
+    ~CacheMissCounter() {
+#ifdef __linux__
+        if (l1Fd >= 0) close(l1Fd);
+        if (llcFd >= 0) close(llcFd);
+#endif
+    }
+
+    CacheMissCounter(CacheMissCounter const&) = delete;
+    void operator=(CacheMissCounter const&) = delete;
+
+    bool available() const { return l1Fd >= 0 || llcFd >= 0; }
+
+    void start() {
+#ifdef __linux__
+        for (int fd : {l1Fd, llcFd}) {
+            if (fd < 0) continue;
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        for (int fd : {l1Fd, llcFd})
+            if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        l1Misses = read(l1Fd);
+        llcMisses = read(llcFd);
+#endif
+    }
+};
+
+#endif //ITU_GRAPHICS_PROGRAMMING_PERF_COUNTERS_H
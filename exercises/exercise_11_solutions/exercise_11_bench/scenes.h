@@ -0,0 +1,74 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_BENCH_SCENES_H
+#define ITU_GRAPHICS_PROGRAMMING_BENCH_SCENES_H
+
+#include <vector>
+#include <string>
+#include <cfloat>
+
+#include <glm/gtx/transform.hpp>
+#include "rt_types.h"
+#include "primitives.h"
+#include "objloader.h"
+
+// the scenes we benchmark, all of them are something inside the grey room of exercise 11, so every ray hits a wall
+namespace BenchScenes {
+
+    inline void addRoom(std::vector<rt::vertex> &vts) {
+        std::vector<glm::vec3> points, normals;
+        std::vector<glm::vec4> colors;
+        std::vector<glm::vec2> uvs;
+        Primitives::makeCube(2.f, points, normals, uvs, colors);
+        glm::mat4 outsideout = glm::scale(glm::vec3(-2.f, -2.f, -2.f));
+        for (unsigned int i = 0; i < points.size(); i++)
+            vts.push_back(rt::vertex{outsideout * glm::vec4(points[i], 1.0f), glm::vec4(normals[i], 0), rt::Colors::grey, uvs[i]});
+    }
+
+    // the scene of exercise_11_sol, the small colored cube
+    inline std::vector<rt::vertex> cube() {
+        std::vector<glm::vec3> points, normals;
+        std::vector<glm::vec4> colors;
+        std::vector<glm::vec2> uvs;
+        std::vector<rt::vertex> vts;
+        Primitives::makeCube(2.f, points, normals, uvs, colors);
+        glm::mat4 scale = glm::scale(glm::vec3(.25f, .25f, .25f));
+        for (unsigned int i = 0; i < points.size(); i++)
+            vts.push_back(rt::vertex{scale * glm::vec4(points[i], 1.0f), glm::vec4(normals[i], 0), colors[i], uvs[i]});
+        addRoom(vts);
+        return vts;
+    }
+
+    // a red sphere of stacks * stacks * 4 triangles
+    inline std::vector<rt::vertex> sphere(unsigned int stacks) {
+        std::vector<glm::vec3> points, normals;
+        std::vector<glm::vec4> colors;
+        std::vector<glm::vec2> uvs;
+        std::vector<rt::vertex> vts;
+        Primitives::makeSphere(.5f, stacks, stacks * 2, points, normals, uvs, colors, rt::Colors::red);
+        for (unsigned int i = 0; i < points.size(); i++)
+            vts.push_back(rt::vertex{glm::vec4(points[i], 1.0f), glm::vec4(normals[i], 0), colors[i], uvs[i]});
+        addRoom(vts);
+        return vts;
+    }
+
+    // a model, centered and scaled to fit a unit sphere. returns false if it can't be loaded
+    inline bool obj(const std::string &path, std::vector<rt::vertex> &vts) {
+        std::vector<glm::vec3> points, normals;
+        std::vector<glm::vec2> uvs;
+        if (!loadOBJ(path.c_str(), points, uvs, normals) || points.empty()) return false;
+
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+        for (const glm::vec3 &p : points) {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        float radius = glm::length(hi - lo) * .5f;
+        glm::mat4 fit = glm::scale(glm::vec3(radius > 0 ? 1.0f / radius : 1.0f)) * glm::translate(-(lo + hi) * .5f);
+        vts.clear();
+        for (unsigned int i = 0; i < points.size(); i++)
+            vts.push_back(rt::vertex{fit * glm::vec4(points[i], 1.0f), glm::vec4(normals[i], 0), rt::Colors::white, uvs[i]});
+        addRoom(vts);
+        return true;
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_BENCH_SCENES_H
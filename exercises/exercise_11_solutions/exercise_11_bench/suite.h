@@ -0,0 +1,211 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_BENCH_SUITE_H
+#define ITU_GRAPHICS_PROGRAMMING_BENCH_SUITE_H
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <algorithm>
+
+#include <glm/gtx/transform.hpp>
+#include "rt_renderer.h"
+
+// renders fixed scenes with a fixed camera, resolution and depth, and measures the rays per second of each type of ray
+// the renderer traces on its own: primary rays and reflections (closest hit queries) and shadow rays (any hit queries)
+namespace BenchSuite {
+
+    // same light as rt::Renderer::shadeHit
+    const glm::vec3 light_pos(0, 1.9f, 0);
+
+    // rays of one type, and what we measured tracing them
+    struct RaySet {
+        std::vector<rt::Ray> rays;
+        // distance to the light, only for shadow rays
+        std::vector<float> tMax;
+        unsigned long long triangleTests = 0;
+        unsigned long long traced = 0;
+        // rays that hit something (shadow rays: that were blocked), out of traced
+        unsigned long long hits = 0;
+        double seconds = 0;
+
+        double raysPerSecond() const { return seconds > 0 ? traced / seconds : 0; }
+        double hitsPerRay() const { return traced > 0 ? double(hits) / traced : 0; }
+        double testsPerRay() const { return rays.empty() ? 0 : double(triangleTests) / rays.size(); }
+    };
+
+    struct SceneResult {
+        std::string name;
+        unsigned int triangles = 0;
+        float bvhBuildMs = 0;
+        unsigned int width = 0, height = 0, depth = 0, threads = 0;
+        // fastest of a few calls to render, and the rays it traced
+        double frameMs = 0;
+        rt::RayStats stats;
+        RaySet primary, shadow, secondary;
+    };
+
+    // the rays the renderer traces for one image: the primary ray of every pixel, a shadow ray from every hit towards
+    // the light, and the reflection of every hit up to depth levels (with the offsets rt::Renderer::shadeHit uses)
+    inline void collectRays(const rt::Renderer &renderer, const std::vector<rt::vertex> &vts, const rt::ImagePlane &plane,
+                            unsigned int W, unsigned int H, unsigned int depth, SceneResult &result) {
+        for (unsigned int r = 0; r < H; r++) {
+            for (unsigned int c = 0; c < W; c++) {
+                rt::Ray ray = plane.rayThrough(c, r);
+                result.primary.rays.push_back(ray);
+                for (unsigned int level = depth; level > 0; level--) {
+                    rt::Hit hit;
+                    if (!renderer.closestHit(ray, vts, hit)) break;
+                    const rt::vertex *v = &vts[hit.hit_ID];
+                    glm::vec3 normal = glm::normalize(glm::vec3(v[0].norm * hit.barycentric.x + v[1].norm * hit.barycentric.y +
+                                                                v[2].norm * hit.barycentric.z));
+                    glm::vec3 p = ray.origin + ray.direction * hit.dist;
+
+                    result.shadow.rays.emplace_back(p + normal * .001f, glm::normalize(light_pos - p));
+                    result.shadow.tMax.push_back(glm::length(light_pos - p));
+                    if (level == 1) break;
+
+                    rt::Ray reflected(p - ray.direction * .001f, glm::reflect(ray.direction, normal));
+                    result.secondary.rays.push_back(reflected);
+                    ray = reflected;
+                }
+            }
+        }
+    }
+
+    // triangles the renderer intersects for a ray. we run the same traversal again rather than counting in the
+    // renderer, so that counting does not slow down the rays we time
+    inline unsigned long long triangleTests(const rt::BVH &bvh, const std::vector<rt::triangle> &tris,
+                                            const rt::Ray &ray, float tMax, bool anyHit) {
+        unsigned long long tests = 0;
+        bvh.traverse(ray, tMax, [&](unsigned int tri, float &t){
+            tests++;
+            float dist;
+            glm::vec3 barycentric;
+            if (!rt::Renderer::rayTriangleIntersection(ray, tris[tri], dist, barycentric) || dist >= t) return false;
+            if (anyHit) return true;
+            t = dist;
+            return false;
+        });
+        return tests;
+    }
+
+    // traces the rays until enough time has gone by to trust the timer
+    inline void measure(const rt::Renderer &renderer, const std::vector<rt::vertex> &vts, const rt::BVH &bvh,
+                        const std::vector<rt::triangle> &tris, bool shadowRays, RaySet &set) {
+        if (set.rays.empty()) return;
+        auto start = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed(0);
+        do {
+            for (unsigned int i = 0; i < set.rays.size(); i++) {
+                rt::Hit hit;
+                set.hits += shadowRays ? renderer.occluded(set.rays[i], set.tMax[i], vts) :
+                                         renderer.closestHit(set.rays[i], vts, hit);
+            }
+            set.traced += set.rays.size();
+            elapsed = std::chrono::high_resolution_clock::now() - start;
+        } while (elapsed.count() < 0.25);
+        set.seconds = elapsed.count();
+
+        for (unsigned int i = 0; i < set.rays.size(); i++)
+            set.triangleTests += triangleTests(bvh, tris, set.rays[i], shadowRays ? set.tMax[i] : FLT_MAX, shadowRays);
+    }
+
+    inline SceneResult run(const std::string &name, const std::vector<rt::vertex> &vts, unsigned int resolution,
+                           unsigned int depth, unsigned int threads) {
+        SceneResult result;
+        result.name = name;
+        result.triangles = (unsigned int) (vts.size() / 3);
+        result.width = result.height = resolution;
+        result.depth = depth;
+        result.threads = threads;
+
+        // the same setup as the window of exercise_11_sol
+        rt::BVH bvh;
+        bvh.build(vts);
+        result.bvhBuildMs = bvh.buildTimeMs;
+        std::vector<rt::triangle> tris = rt::makeTriangles(vts);
+        rt::TriangleSoA packetTriangles(vts);
+        rt::Renderer renderer;
+        renderer.setAccelerationStructure(&bvh);
+        renderer.setCompactTriangles(&tris);
+        renderer.setPacketTriangles(&packetTriangles);
+        renderer.setThreadCount(threads);
+
+        FrameBuffer<uint32_t> fb(resolution, resolution);
+        glm::mat4 view = glm::lookAt(glm::vec3(0.9f, 0.0f, 1.5f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        // whole frames, the fastest of a few is the least disturbed by whatever else the machine is doing
+        result.frameMs = -1;
+        for (int frame = 0; frame < 3; frame++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            renderer.render(vts, glm::mat4(1), view, 70.0f, depth, fb);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            if (result.frameMs < 0 || elapsed.count() < result.frameMs) result.frameMs = elapsed.count();
+        }
+        result.stats = renderer.stats;
+
+        // each type of ray on its own
+        rt::ImagePlane plane(glm::mat4(1), view, 70.0f, fb);
+        collectRays(renderer, vts, plane, fb.W, fb.H, depth, result);
+        measure(renderer, vts, bvh, tris, false, result.primary);
+        measure(renderer, vts, bvh, tris, true, result.shadow);
+        measure(renderer, vts, bvh, tris, false, result.secondary);
+        return result;
+    }
+
+    inline void print(const SceneResult &result) {
+        printf("%-8s %8u triangles, %ux%u depth %u: %8.2f ms per frame, %7.3f Mrays/s\n", result.name.c_str(),
+               result.triangles, result.width, result.height, result.depth, result.frameMs,
+               result.stats.total() / result.frameMs * 1e-3);
+        const RaySet *sets[] = {&result.primary, &result.shadow, &result.secondary};
+        const char *names[] = {"primary", "shadow", "secondary"};
+        for (int i = 0; i < 3; i++)
+            printf("    %-10s %9zu rays %8.3f Mrays/s %8.2f triangle tests per ray\n", names[i], sets[i]->rays.size(),
+                   sets[i]->raysPerSecond() * 1e-6, sets[i]->testsPerRay());
+    }
+
+    namespace detail {
+        inline void writeRaySet(FILE *file, const char *name, const RaySet &set, bool last) {
+            fprintf(file, "      \"%s\": {\"rays\": %zu, \"rays_per_second\": %.1f, \"triangle_tests_per_ray\": %.3f, "
+                    "\"hits_per_ray\": %.3f}%s\n",
+                    name, set.rays.size(), set.raysPerSecond(), set.testsPerRay(), set.hitsPerRay(), last ? "" : ",");
+        }
+
+        // scene names and labels are ours or come from the command line, we only need to escape quotes and backslashes
+        inline std::string escape(const std::string &text) {
+            std::string escaped;
+            for (char ch : text) {
+                if (ch == '"' || ch == '\\') escaped += '\\';
+                escaped += ch;
+            }
+            return escaped;
+        }
+    }
+
+    inline bool writeJSON(const char *path, const std::string &label, const std::vector<SceneResult> &results) {
+        FILE *file = fopen(path, "w");
+        if (file == NULL) return false;
+        fprintf(file, "{\n  \"label\": \"%s\",\n  \"scenes\": [\n", detail::escape(label).c_str());
+        for (unsigned int i = 0; i < results.size(); i++) {
+            const SceneResult &result = results[i];
+            fprintf(file, "    {\n");
+            fprintf(file, "      \"name\": \"%s\",\n", detail::escape(result.name).c_str());
+            fprintf(file, "      \"triangles\": %u,\n", result.triangles);
+            fprintf(file, "      \"width\": %u,\n      \"height\": %u,\n", result.width, result.height);
+            fprintf(file, "      \"depth\": %u,\n      \"threads\": %u,\n", result.depth, result.threads);
+            fprintf(file, "      \"bvh_build_ms\": %.3f,\n", result.bvhBuildMs);
+            fprintf(file, "      \"frame_ms\": %.3f,\n", result.frameMs);
+            fprintf(file, "      \"frame_rays\": {\"primary\": %llu, \"shadow\": %llu, \"secondary\": %llu},\n",
+                    result.stats.primary, result.stats.shadow, result.stats.secondary);
+            fprintf(file, "      \"frame_rays_per_second\": %.1f,\n", result.stats.total() / result.frameMs * 1e3);
+            detail::writeRaySet(file, "primary", result.primary, false);
+            detail::writeRaySet(file, "shadow", result.shadow, false);
+            detail::writeRaySet(file, "secondary", result.secondary, true);
+            fprintf(file, "    }%s\n", i + 1 < results.size() ? "," : "");
+        }
+        fprintf(file, "  ]\n}\n");
+        return fclose(file) == 0;
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_BENCH_SUITE_H
@@ -29,6 +29,8 @@ rt::Renderer renderer;
 
 float deltaTime = 0;
 unsigned int rtDepth = 2;
+bool progressive = false;
+bool antialiasing = false;
 
 int main()
 {
@@ -100,12 +102,28 @@ int main()
         vts.push_back(v);
     }
 
+    // build the acceleration structure once, it is used by every ray the renderer traces
+    rt::BVH bvh;
+    bvh.build(vts);
+    std::cout << "BVH built over " << bvh.primitiveCount() << " triangles: " << bvh.nodes.size() << " nodes in "
+              << bvh.buildTimeMs << " ms" << std::endl;
+    renderer.setAccelerationStructure(&bvh);
+    // intersection-only copy of the triangles, 48 bytes each instead of the 168 bytes of three vertices
+    std::vector<rt::triangle> compactTriangles = rt::makeTriangles(vts);
+    renderer.setCompactTriangles(&compactTriangles);
+    // copy of the triangles laid out for SIMD, primary rays of neighbouring pixels are intersected together
+    rt::TriangleSoA packetTriangles(vts);
+    renderer.setPacketTriangles(&packetTriangles);
+    // render tiles of the image in parallel, one thread per core
+    renderer.setThreadCount(0);
+    renderer.setTileSize(8);
 
 
     // initialize our custom frame buffer
     // ----------------------------------
     // every frame we will: draw to it, upload it to a texture, and copy the texture to the window frame buffer.
-    FrameBuffer<uint32_t> customBuffer(max_W, max_H);
+    // the pixels are stored in 8x8 blocks, the same size as the tiles the render threads get
+    FrameBuffer<uint32_t> customBuffer(max_W, max_H, PixelLayout::Tiled);
 
 
     // initialize texture we will use to upload our buffer to GPU
@@ -121,6 +139,11 @@ int main()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    // pixel buffer object the frame buffer is linearized into, the texture is then uploaded from it
+    GLuint pixelBuffer = 0;
+    glGenBuffers(1, &pixelBuffer);
+    GLsizeiptr pixelBufferSize = max_W * max_H * sizeof(uint32_t);
+
     // initialize openGL frame buffer object
     // ------------------------------------
     // this helps handling writing the texture content into the window frame buffer
@@ -139,6 +162,9 @@ int main()
     std::cout << "3 - two reflections" << std::endl;
     std::cout << "4 - three reflections" << std::endl;
     std::cout << "5 - four reflections" << std::endl;
+    std::cout << "0 - as many reflections as are visible" << std::endl;
+    std::cout << "P - toggle progressive rendering" << std::endl;
+    std::cout << "X - toggle adaptive anti-aliasing (not progressive)" << std::endl;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -154,14 +180,35 @@ int main()
 
         glm::mat4 scale = glm::scale(glm::vec3(.5f,.5f,.5f));
 
-        renderer.render(vts, glm::mat4(1), camera.GetViewMatrix(), 70.0f, rtDepth, customBuffer);
+        auto renderStart = std::chrono::high_resolution_clock::now();
+        bool converged = false;
+        if (progressive)
+            // refine the image for (about) the duration of one frame, instead of waiting for the next one
+            converged = renderer.renderProgressive(vts, glm::mat4(1), camera.GetViewMatrix(), 70.0f, rtDepth, customBuffer, loopInterval);
+        else {
+            renderer.setAdaptiveSampling(antialiasing ? 4 : 0);
+            renderer.render(vts, glm::mat4(1), camera.GetViewMatrix(), 70.0f, rtDepth, customBuffer);
+        }
+        std::chrono::duration<float> renderTime = std::chrono::high_resolution_clock::now() - renderStart;
+        float raysPerSecond = renderer.stats.total() / renderTime.count();
 
         // show our rendered image
         // -----------------------
         // upload the custom color buffer to the GPU using the texture
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, bufferTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, max_W, max_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, customBuffer.buffer);
+        // write the pixels, in row order, straight into memory the driver owns. glBufferData with no data lets the
+        // driver give us new memory instead of waiting for the upload of the previous frame to finish
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, pixelBufferSize, NULL, GL_STREAM_DRAW);
+        void *pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, pixelBufferSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (pixels) {
+            customBuffer.linearize(static_cast<uint32_t *>(pixels));
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            // with a pixel unpack buffer bound, the last argument is an offset in it
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, max_W, max_H, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void *) 0);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 
         // set opengl frame buffer object to read from our texture, we will copy from it
         glBindFramebuffer(GL_READ_FRAMEBUFFER, oglFrameBuffer);
@@ -180,12 +227,29 @@ int main()
         glfwPollEvents();
 
         // control render loop frequency (busy wait)
+        // in progressive mode the renderer already used the frame time, and once the image has converged we
+        // sleep until there is some input instead of spinning
         std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now()-frameStart;
-        while (loopInterval > elapsed.count()) {
-            elapsed = std::chrono::high_resolution_clock::now() - frameStart;
+        if (converged)
+            glfwWaitEventsTimeout(loopInterval);
+        else if (!progressive) {
+            while (loopInterval > elapsed.count()) {
+                elapsed = std::chrono::high_resolution_clock::now() - frameStart;
+            }
         }
+        elapsed = std::chrono::high_resolution_clock::now() - frameStart;
         deltaTime = elapsed.count();
-        glfwSetWindowTitle(window, ("Exercise 11 - FPS: " + std::to_string(int(1.0f/deltaTime + .5f))).c_str());
+        std::string title = "Exercise 11 - FPS: " + std::to_string(int(1.0f/deltaTime + .5f)) +
+                            " - Mrays/s: " + std::to_string(raysPerSecond * 1e-6f);
+        if (progressive)
+            title += " - samples: " + std::to_string(renderer.progressivePasses());
+        else if (antialiasing)
+            title += " - antialiased pixels: " + std::to_string(renderer.stats.supersampled);
+#ifdef RT_ENABLE_COUNTERS
+        // detailed counters of the last frame
+        title += " - " + renderer.stats.describeCounters();
+#endif
+        glfwSetWindowTitle(window, title.c_str());
     }
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -235,6 +299,18 @@ void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) rtDepth = 3;
     if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) rtDepth = 4;
     if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) rtDepth = 5;
+    // the renderer stops bouncing once reflections are too faint to see, so this costs little more than 5
+    if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS) rtDepth = 16;
+
+    // toggle on press, not while the key is held
+    static bool progressiveKeyDown = false;
+    bool pDown = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+    if (pDown && !progressiveKeyDown) progressive = !progressive;
+    progressiveKeyDown = pDown;
+    static bool antialiasingKeyDown = false;
+    bool xDown = glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS;
+    if (xDown && !antialiasingKeyDown) antialiasing = !antialiasing;
+    antialiasingKeyDown = xDown;
 
     // movement commands
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
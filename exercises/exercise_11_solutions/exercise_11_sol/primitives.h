@@ -111,6 +111,47 @@ public:
                              });
     }
 
+    // UV sphere centered at the origin, made of stacks * slices quads (two triangles each)
+    static void makeSphere(float radius, unsigned int stacks, unsigned int slices,
+                           std::vector<glm::vec3>& positions,
+                           std::vector<glm::vec3>& normals,
+                           std::vector<glm::vec2>& uvs,
+                           std::vector<glm::vec4>& colors,
+                           glm::vec4 color = glm::vec4(.9, .9, .9, 1)){
+        using namespace glm;
+        using namespace std;
+
+        const float pi = 3.14159265358979f;
+        // point of the sphere at the given stack (from the top) and slice
+        auto normalAt = [&](unsigned int stack, unsigned int slice){
+            float theta = pi * stack / stacks;
+            float phi = 2.0f * pi * slice / slices;
+            return vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+        };
+        auto uvAt = [&](unsigned int stack, unsigned int slice){
+            return vec2(float(slice) / slices, 1.0f - float(stack) / stacks);
+        };
+
+        positions.clear(); normals.clear(); uvs.clear(); colors.clear();
+        size_t count = size_t(stacks) * slices * 6;
+        positions.reserve(count); normals.reserve(count); uvs.reserve(count); colors.reserve(count);
+
+        for (unsigned int i = 0; i < stacks; i++){
+            for (unsigned int j = 0; j < slices; j++){
+                // the quad between stacks i, i+1 and slices j, j+1, split in two triangles
+                unsigned int corners[6][2] = {{i, j}, {i + 1, j}, {i + 1, j + 1},
+                                              {i, j}, {i + 1, j + 1}, {i, j + 1}};
+                for (auto &c : corners){
+                    vec3 n = normalAt(c[0], c[1]);
+                    positions.push_back(n * radius);
+                    normals.push_back(n);
+                    uvs.push_back(uvAt(c[0], c[1]));
+                    colors.push_back(color);
+                }
+            }
+        }
+    }
+
 
 };
 
@@ -5,35 +5,124 @@
 #ifndef ITU_GRAPHICS_PROGRAMMING_FRAME_BUFFER_H
 #define ITU_GRAPHICS_PROGRAMMING_FRAME_BUFFER_H
 
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAME_BUFFER_SSE
+#endif
+
+
+// orders in which a FrameBuffer can store its pixels
+enum class PixelLayout {
+    // row after row, the order OpenGL expects
+    Linear,
+    // blocks of 8x8 pixels, each block row after row and the blocks row after row. a block of 4 byte pixels is
+    // 4 cache lines, so a small tile of the image touches few cache lines, and threads rendering different tiles
+    // (of a multiple of 8 pixels) never write to the same cache line
+    Tiled
+};
 
 template<class T>
 class FrameBuffer {
+    static_assert(std::is_trivially_copyable<T>::value, "FrameBuffer pixels are copied and cleared as raw memory");
+
+    unsigned char *storage;
+    // number of pixels allocated, including the padding
+    size_t capacity;
+    unsigned int blocksX;
+
 public:
+    // side of the blocks of PixelLayout::Tiled
+    static const unsigned int block_size = 8;
+    // the first pixel is at a multiple of this many bytes (one cache line)
+    static const size_t alignment = 64;
+
     unsigned int W, H;
+    const PixelLayout layout;
+    // the pixels, in the order given by layout. with PixelLayout::Linear, pixel (x, y) is buffer[x + y * W]
     T *buffer;
 
-    FrameBuffer(unsigned int width, unsigned int height) : W(width), H(height) {
-        buffer = new T[W * H];
+    FrameBuffer(unsigned int width, unsigned int height, PixelLayout pixelLayout = PixelLayout::Linear)
+            : W(width), H(height), layout(pixelLayout) {
+        blocksX = (W + block_size - 1) / block_size;
+        unsigned int blocksY = (H + block_size - 1) / block_size;
+        // tiled buffers hold whole blocks, linear ones are padded to a multiple of 16 pixels so that clearBuffer
+        // doesn't need a loop for the last few pixels
+        capacity = layout == PixelLayout::Tiled ? size_t(blocksX) * blocksY * block_size * block_size :
+                   (size_t(W) * H + 15) / 16 * 16;
+        storage = new unsigned char[capacity * sizeof(T) + alignment];
+        buffer = reinterpret_cast<T *>(storage + (alignment - reinterpret_cast<uintptr_t>(storage) % alignment) % alignment);
     }
 
-    ~FrameBuffer() { delete[] buffer; } // clean our memory
+    ~FrameBuffer() { delete[] storage; } // clean our memory
+
+    FrameBuffer(const FrameBuffer &) = delete;
+    FrameBuffer &operator=(const FrameBuffer &) = delete;
+
+    // position of pixel (x, y) in buffer
+    size_t indexOf(unsigned int x, unsigned int y) const {
+        if (layout == PixelLayout::Linear) return x + size_t(y) * W;
+        return (size_t(y / block_size) * blocksX + x / block_size) * (block_size * block_size) +
+               (y % block_size) * block_size + x % block_size;
+    }
+
+    // number of pixels from column x to the right that follow each other in buffer, up to the end of the row (the
+    // same in every row)
+    unsigned int contiguousFrom(unsigned int x) const {
+        if (layout == PixelLayout::Linear) return W - x;
+        return std::min(block_size - x % block_size, W - x);
+    }
 
     void clearBuffer(T value) {
-        int size = W * H;
-        for (int i = 0; i < size; i++)
-            buffer[i] = value;
+#ifdef FRAME_BUFFER_SSE
+        if (sizeof(T) == 4) {
+            // 4 pixels per store, the buffer is aligned and its capacity is a multiple of 16 pixels
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            __m128i pixels = _mm_set1_epi32(int(bits));
+            __m128i *dst = reinterpret_cast<__m128i *>(buffer);
+            __m128i *end = reinterpret_cast<__m128i *>(buffer + capacity);
+            for (; dst < end; dst++) _mm_store_si128(dst, pixels);
+            return;
+        }
+#endif
+        std::fill_n(buffer, capacity, value);
     }
 
     void paintAt(unsigned int x, unsigned int y, T value) {
         assert(x < W && y < H); // ensure valid position, crash if not (sooo dramatic!)
-        buffer[x + y * W] = value;
+        buffer[indexOf(x, y)] = value;
     }
 
-    T valueAt(unsigned int x, unsigned int y) {
+    // paintAt without the bounds check, for loops that only go through valid positions
+    void paintAtUnchecked(unsigned int x, unsigned int y, T value) {
+        buffer[indexOf(x, y)] = value;
+    }
+
+    T valueAt(unsigned int x, unsigned int y) const {
         assert(x < W && y < H);
-        return buffer[x + y * W];
+        return buffer[indexOf(x, y)];
     }
 
+    // writes the W * H pixels to dst row after row, whatever the layout. dst can be the mapped memory of a pixel
+    // buffer object, which OpenGL then uploads to a texture without another copy in client memory
+    void linearize(T *dst) const {
+        if (layout == PixelLayout::Linear) {
+            memcpy(dst, buffer, sizeof(T) * W * H);
+            return;
+        }
+        for (unsigned int y = 0; y < H; y++) {
+            for (unsigned int bx = 0; bx < blocksX; bx++) {
+                unsigned int x = bx * block_size;
+                memcpy(dst + x + size_t(y) * W, buffer + indexOf(x, y), sizeof(T) * std::min(block_size, W - x));
+            }
+        }
+    }
 };
 
 
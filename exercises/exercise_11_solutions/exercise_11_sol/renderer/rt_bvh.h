@@ -0,0 +1,280 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+
+namespace rt{
+    using namespace glm;
+
+    // axis aligned bounding box, starts "inverted" so that the first grow() sets it to a single point
+    struct AABB{
+        vec3 min = vec3(FLT_MAX);
+        vec3 max = vec3(-FLT_MAX);
+
+        void grow(const vec3 &p) { min = glm::min(min, p); max = glm::max(max, p); }
+        void grow(const AABB &b) { if (b.min.x != FLT_MAX) { grow(b.min); grow(b.max); } }
+
+        vec3 centroid() const { return (min + max) * .5f; }
+
+        // grows the box by a tiny margin relative to its position, a triangle test can accept a ray that grazes an
+        // edge lying just outside the exact bounds (e.g. a ray parallel to a face and rounded onto it)
+        void pad() {
+            vec3 eps = (glm::abs(min) + glm::abs(max) + vec3(1.0f)) * 1e-6f;
+            min -= eps;
+            max += eps;
+        }
+
+        // half of the surface area is enough for the surface area heuristic, only ratios matter
+        float area() const {
+            vec3 e = max - min;
+            return e.x < 0 ? 0 : e.x * e.y + e.y * e.z + e.z * e.x;
+        }
+
+        // slab test, returns the distance to the entry point in tNear (which can be negative if the origin is inside)
+        bool intersect(const vec3 &origin, const vec3 &invDir, float tMax, float &tNear) const {
+            vec3 t0 = (min - origin) * invDir;
+            vec3 t1 = (max - origin) * invDir;
+            vec3 tSmall = glm::min(t0, t1);
+            vec3 tBig = glm::max(t0, t1);
+            tNear = glm::max(glm::max(tSmall.x, tSmall.y), tSmall.z);
+            float tFar = glm::min(glm::min(tBig.x, tBig.y), tBig.z);
+            return tFar >= tNear && tFar >= 0 && tNear < tMax;
+        }
+    };
+
+    struct BVHNode{
+        AABB bounds;
+        // index of the left child for inner nodes (the right child is always leftFirst + 1),
+        // or index of the first primitive in BVH::indices for leaves
+        unsigned int leftFirst = 0;
+        // number of primitives in a leaf, 0 for inner nodes
+        unsigned int count = 0;
+
+        bool isLeaf() const { return count > 0; }
+    };
+
+    // bounding volume hierarchy built with a binned surface area heuristic (SAH).
+    // the hierarchy does not store geometry, only indices to the primitives it was built from, the actual
+    // intersection tests are done by whoever calls traverse().
+    class BVH{
+        // number of candidate split planes tested per axis
+        static const unsigned int sah_bins = 16;
+        // we never split nodes with fewer primitives than this
+        static const unsigned int min_leaf_size = 2;
+        // relative cost of visiting a node compared to testing one primitive
+        constexpr static const float traversal_cost = 1.0f;
+
+    public:
+        std::vector<BVHNode> nodes;
+        // primitive indices, reordered so that each leaf references a contiguous range
+        std::vector<unsigned int> indices;
+        // time spent in the last call to build, in milliseconds
+        float buildTimeMs = 0;
+
+        bool empty() const { return nodes.empty(); }
+        unsigned int primitiveCount() const { return (unsigned int) indices.size(); }
+
+        // builds the hierarchy over the triangles of a flat vertex list (3 vertices per triangle),
+        // primitive i is the triangle made of vts[3i], vts[3i+1] and vts[3i+2]
+        void build(const std::vector<vertex> &vts){
+            std::vector<AABB> bounds(vts.size() / 3);
+            for (unsigned int i = 0; i < bounds.size(); i++){
+                bounds[i].grow(vec3(vts[i * 3].pos));
+                bounds[i].grow(vec3(vts[i * 3 + 1].pos));
+                bounds[i].grow(vec3(vts[i * 3 + 2].pos));
+                bounds[i].pad();
+            }
+            build(bounds);
+        }
+
+        // builds the hierarchy over any set of primitives, given their bounding boxes
+        void build(const std::vector<AABB> &primBounds){
+            auto start = std::chrono::high_resolution_clock::now();
+
+            unsigned int n = (unsigned int) primBounds.size();
+            nodes.clear();
+            indices.resize(n);
+            centroids.resize(n);
+            for (unsigned int i = 0; i < n; i++){
+                indices[i] = i;
+                centroids[i] = primBounds[i].centroid();
+            }
+
+            if (n > 0) {
+                // a binary tree with at most one primitive per leaf has at most 2n - 1 nodes
+                nodes.reserve(2 * n - 1);
+                nodes.emplace_back();
+                nodes[0].leftFirst = 0;
+                nodes[0].count = n;
+                updateBounds(0, primBounds);
+                subdivide(0, primBounds);
+            }
+
+            // the centroids are only needed while building
+            centroids.clear();
+            centroids.shrink_to_fit();
+
+            std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            buildTimeMs = elapsed.count();
+        }
+
+        // walks the nodes hit by the ray, closest first, calling leafTest(primitiveIndex, tMax) for every primitive in
+        // the leaves that are reached. leafTest shrinks tMax when it finds a closer hit, so that farther nodes are culled,
+        // and returns true to end the traversal early (e.g. when any hit is enough)
+        template<typename LeafTest>
+        void traverse(const Ray &ray, float &tMax, LeafTest leafTest) const{
+            if (nodes.empty()) return;
+
+            vec3 invDir = 1.0f / ray.direction;
+            // deep enough for any tree built by subdivide, which stops at depth 64
+            unsigned int stack[64];
+            unsigned int stackSize = 0;
+            unsigned int nodeIdx = 0;
+
+            float tNear;
+            if (!nodes[0].bounds.intersect(ray.origin, invDir, tMax, tNear)) return;
+
+            while (true) {
+                const BVHNode &node = nodes[nodeIdx];
+                if (node.isLeaf()) {
+                    for (unsigned int i = 0; i < node.count; i++) {
+                        if (leafTest(indices[node.leftFirst + i], tMax)) return;
+                    }
+                } else {
+                    // visit the closest child first, so that tMax shrinks as early as possible
+                    unsigned int first = node.leftFirst, second = node.leftFirst + 1;
+                    float tFirst, tSecond;
+                    bool hitFirst = nodes[first].bounds.intersect(ray.origin, invDir, tMax, tFirst);
+                    bool hitSecond = nodes[second].bounds.intersect(ray.origin, invDir, tMax, tSecond);
+                    if (hitFirst && hitSecond) {
+                        if (tSecond < tFirst) std::swap(first, second);
+                        stack[stackSize++] = second;
+                        nodeIdx = first;
+                        continue;
+                    }
+                    if (hitFirst) { nodeIdx = first; continue; }
+                    if (hitSecond) { nodeIdx = second; continue; }
+                }
+
+                // pop the next node that can still contain a closer hit
+                bool found = false;
+                while (stackSize > 0) {
+                    nodeIdx = stack[--stackSize];
+                    if (nodes[nodeIdx].bounds.intersect(ray.origin, invDir, tMax, tNear)) {
+                        found = true;
+                        break;
+                    }
+                }
+                if (!found) return;
+            }
+        }
+
+    private:
+        // primitive centroids, used during build only
+        std::vector<vec3> centroids;
+
+        void updateBounds(unsigned int nodeIdx, const std::vector<AABB> &primBounds){
+            BVHNode &node = nodes[nodeIdx];
+            node.bounds = AABB();
+            for (unsigned int i = 0; i < node.count; i++)
+                node.bounds.grow(primBounds[indices[node.leftFirst + i]]);
+        }
+
+        // finds the cheapest split plane according to the SAH, binning the primitive centroids along each axis.
+        // returns the cost of that split, or FLT_MAX if the centroids can't be separated
+        float findBestSplit(const BVHNode &node, const std::vector<AABB> &primBounds, int &bestAxis, float &bestPos) const{
+            // bin over the centroid bounds rather than the node bounds, so that no bin is wasted
+            AABB centroidBounds;
+            for (unsigned int i = 0; i < node.count; i++)
+                centroidBounds.grow(centroids[indices[node.leftFirst + i]]);
+
+            float bestCost = FLT_MAX;
+            for (int axis = 0; axis < 3; axis++) {
+                float cMin = centroidBounds.min[axis], cMax = centroidBounds.max[axis];
+                if (cMin == cMax) continue;
+
+                AABB binBounds[sah_bins];
+                unsigned int binCount[sah_bins] = {0};
+                float scale = sah_bins / (cMax - cMin);
+                for (unsigned int i = 0; i < node.count; i++) {
+                    unsigned int prim = indices[node.leftFirst + i];
+                    unsigned int b = std::min(sah_bins - 1, (unsigned int) ((centroids[prim][axis] - cMin) * scale));
+                    binCount[b]++;
+                    binBounds[b].grow(primBounds[prim]);
+                }
+
+                // sweep from both sides to get the area and count on each side of every plane between two bins
+                float leftArea[sah_bins - 1], rightArea[sah_bins - 1];
+                unsigned int leftCount[sah_bins - 1], rightCount[sah_bins - 1];
+                AABB leftBox, rightBox;
+                unsigned int leftSum = 0, rightSum = 0;
+                for (unsigned int i = 0; i < sah_bins - 1; i++) {
+                    leftSum += binCount[i];
+                    leftCount[i] = leftSum;
+                    leftBox.grow(binBounds[i]);
+                    leftArea[i] = leftBox.area();
+                    rightSum += binCount[sah_bins - 1 - i];
+                    rightCount[sah_bins - 2 - i] = rightSum;
+                    rightBox.grow(binBounds[sah_bins - 1 - i]);
+                    rightArea[sah_bins - 2 - i] = rightBox.area();
+                }
+
+                for (unsigned int i = 0; i < sah_bins - 1; i++) {
+                    if (leftCount[i] == 0 || rightCount[i] == 0) continue;
+                    float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestPos = cMin + (i + 1) / scale;
+                    }
+                }
+            }
+            return bestCost;
+        }
+
+        void subdivide(unsigned int nodeIdx, const std::vector<AABB> &primBounds, unsigned int depth = 0){
+            BVHNode node = nodes[nodeIdx];
+            if (node.count < min_leaf_size || depth >= 63) return;
+
+            int axis = 0;
+            float splitPos = 0;
+            float splitCost = findBestSplit(node, primBounds, axis, splitPos);
+            // the cost of intersecting every primitive in this node vs. traversing and intersecting the two children
+            float leafCost = node.count * node.bounds.area();
+            if (splitCost + traversal_cost * node.bounds.area() >= leafCost) return;
+
+            // partition the index range in place, primitives left of the plane go first
+            int i = (int) node.leftFirst;
+            int j = i + (int) node.count - 1;
+            while (i <= j) {
+                if (centroids[indices[i]][axis] < splitPos)
+                    i++;
+                else
+                    std::swap(indices[i], indices[j--]);
+            }
+            unsigned int leftCount = i - node.leftFirst;
+            if (leftCount == 0 || leftCount == node.count) return;
+
+            unsigned int leftIdx = (unsigned int) nodes.size();
+            nodes.emplace_back();
+            nodes.emplace_back();
+            nodes[leftIdx].leftFirst = node.leftFirst;
+            nodes[leftIdx].count = leftCount;
+            nodes[leftIdx + 1].leftFirst = i;
+            nodes[leftIdx + 1].count = node.count - leftCount;
+            nodes[nodeIdx].leftFirst = leftIdx;
+            nodes[nodeIdx].count = 0;
+
+            updateBounds(leftIdx, primBounds);
+            updateBounds(leftIdx + 1, primBounds);
+            subdivide(leftIdx, primBounds, depth + 1);
+            subdivide(leftIdx + 1, primBounds, depth + 1);
+        }
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_BVH_H
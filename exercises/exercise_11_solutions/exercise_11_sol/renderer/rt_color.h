@@ -0,0 +1,159 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_COLOR_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_COLOR_H
+
+#include <cmath>
+#include <cstdint>
+#include "rt_types.h"
+#include "frame_buffer.h"
+
+// pick the widest instruction set the compiler is allowed to use, AVX (2 pixels per instruction), SSE2 (1 pixel)
+// or plain C++
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RT_COLOR_AVX
+#define RT_COLOR_SSE
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RT_COLOR_SSE
+#endif
+
+namespace rt{
+    namespace Colors {
+        // how float colors are turned into 8 bit ones by the batch versions of toRGBA32. with the defaults the result
+        // is exactly what toRGBA32(color) gives
+        struct Conversion {
+            // encode r, g and b with the sRGB transfer function instead of storing the linear values
+            bool srgb = false;
+            // add a 4x4 ordered (Bayer) dither pattern to r, g and b before dropping the fraction, so that smooth
+            // gradients don't turn into bands
+            bool dither = false;
+        };
+
+        namespace detail {
+            static_assert(sizeof(color) == 4 * sizeof(float), "colors are read as 4 consecutive floats");
+
+            // thresholds in [0, 1) of a 4x4 ordered dither, indexed [y % 4][x % 4]
+            inline float ditherThreshold(unsigned int x, unsigned int y) {
+                static const unsigned char bayer[4][4] = {{0, 8, 2, 10}, {12, 4, 14, 6}, {3, 11, 1, 9}, {15, 7, 13, 5}};
+                return (bayer[y & 3][x & 3] + .5f) / 16.0f;
+            }
+
+            // sRGB encoding of a linear value in [0, 1], scaled to [0, 255] and looked up by round(linear * 4095).
+            // 4096 entries are fine enough that neighbouring entries are at most one 8 bit step apart
+            const unsigned int srgb_table_size = 4096;
+            struct SRGBTable {
+                float encoded[srgb_table_size];
+                SRGBTable() {
+                    for (unsigned int i = 0; i < srgb_table_size; i++) {
+                        float linear = float(i) / (srgb_table_size - 1);
+                        float e = linear <= 0.0031308f ? 12.92f * linear : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+                        encoded[i] = 255.0f * e;
+                    }
+                }
+            };
+            inline const float *srgbTable() {
+                static const SRGBTable table;
+                return table.encoded;
+            }
+
+            // c clamped to [0, 1] and converted to [0, 255] (before dropping the fraction), the scalar reference for
+            // the simd code below, which does the same operations in the same order
+            inline void scale(const color &c, const float *srgb, float threshold, float out[4]) {
+                for (int k = 0; k < 4; k++) {
+                    float v = c[k] < 0.0f ? 0.0f : c[k];
+                    v = v > 1.0f ? 1.0f : v;
+                    out[k] = srgb && k < 3 ? srgb[int(v * (srgb_table_size - 1) + .5f)] : 255 * v;
+                    if (k < 3) out[k] += threshold;
+                }
+            }
+
+            inline uint32_t pack(const float v[4]) {
+                return uint32_t(v[0]) + (uint32_t(v[1]) << 8) + (uint32_t(v[2]) << 16) + (uint32_t(v[3]) << 24);
+            }
+
+#if defined(RT_COLOR_SSE)
+            // one pixel, in [0, 255] as 4 int32
+            inline __m128i scalePixel(const color &c, const float *srgb, float threshold) {
+                __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&c[0]), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+                if (srgb) {
+                    // no gather before AVX2, the table lookups are done one channel at a time
+                    alignas(16) float clamped[4];
+                    _mm_store_ps(clamped, v);
+                    v = _mm_set_ps(255 * clamped[3], srgb[int(clamped[2] * (srgb_table_size - 1) + .5f)],
+                                   srgb[int(clamped[1] * (srgb_table_size - 1) + .5f)],
+                                   srgb[int(clamped[0] * (srgb_table_size - 1) + .5f)]);
+                } else {
+                    v = _mm_mul_ps(v, _mm_set1_ps(255.0f));
+                }
+                v = _mm_add_ps(v, _mm_set_ps(0.0f, threshold, threshold, threshold));
+                return _mm_cvttps_epi32(v);
+            }
+
+            // 4 pixels of 4 int32 in [0, 255] to 16 bytes, in the byte order of toRGBA32
+            inline void storePixels(uint32_t *dst, __m128i p0, __m128i p1, __m128i p2, __m128i p3) {
+                __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), bytes);
+            }
+#endif
+#if defined(RT_COLOR_AVX)
+            // two pixels at once, linear encoding only
+            inline __m256i scalePixelPair(const color *c, __m256 thresholds) {
+                __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(&c[0][0]), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+                v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), thresholds);
+                return _mm256_cvttps_epi32(v);
+            }
+#endif
+        }
+
+        // converts count colors of the pixels (x, y), (x + 1, y), ... and writes them, packed as toRGBA32 does, to dst
+        inline void toRGBA32(const color *src, unsigned int count, unsigned int x, unsigned int y, uint32_t *dst,
+                             Conversion conversion = Conversion()) {
+            const float *srgb = conversion.srgb ? detail::srgbTable() : nullptr;
+            // the dither pattern repeats every 4 pixels, and the loops below go 4 pixels at a time
+            float t[4];
+            for (unsigned int k = 0; k < 4; k++) t[k] = conversion.dither ? detail::ditherThreshold(x + k, y) : 0.0f;
+            unsigned int i = 0;
+#if defined(RT_COLOR_AVX)
+            if (!srgb) {
+                __m256 t01 = _mm256_set_ps(0, t[1], t[1], t[1], 0, t[0], t[0], t[0]);
+                __m256 t23 = _mm256_set_ps(0, t[3], t[3], t[3], 0, t[2], t[2], t[2]);
+                for (; i + 4 <= count; i += 4) {
+                    __m256i p01 = detail::scalePixelPair(src + i, t01);
+                    __m256i p23 = detail::scalePixelPair(src + i + 2, t23);
+                    detail::storePixels(dst + i, _mm256_castsi256_si128(p01), _mm256_extractf128_si256(p01, 1),
+                                        _mm256_castsi256_si128(p23), _mm256_extractf128_si256(p23, 1));
+                }
+            }
+#endif
+#if defined(RT_COLOR_SSE)
+            for (; i + 4 <= count; i += 4) {
+                detail::storePixels(dst + i, detail::scalePixel(src[i], srgb, t[0]),
+                                    detail::scalePixel(src[i + 1], srgb, t[1]),
+                                    detail::scalePixel(src[i + 2], srgb, t[2]),
+                                    detail::scalePixel(src[i + 3], srgb, t[3]));
+            }
+#endif
+            for (; i < count; i++) {
+                float v[4];
+                detail::scale(src[i], srgb, t[i & 3], v);
+                dst[i] = detail::pack(v);
+            }
+        }
+
+        // converts the colors of the pixels [x0, x1) x [y0, y1) of fb, given row after row in src, and writes them to fb
+        inline void toRGBA32(const color *src, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+                             FrameBuffer<uint32_t> &fb, Conversion conversion = Conversion()) {
+            for (unsigned int y = y0; y < y1; y++) {
+                const color *row = src + size_t(y - y0) * (x1 - x0);
+                // a row of the frame buffer is only stored in one piece with the linear layout
+                for (unsigned int x = x0; x < x1;) {
+                    unsigned int count = std::min(fb.contiguousFrom(x), x1 - x);
+                    toRGBA32(row + (x - x0), count, x, y, fb.buffer + fb.indexOf(x, y), conversion);
+                    x += count;
+                }
+            }
+        }
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_COLOR_H
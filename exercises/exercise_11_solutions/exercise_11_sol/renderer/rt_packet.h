@@ -0,0 +1,271 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_PACKET_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_PACKET_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+#include "rt_bvh.h"
+
+// pick the widest instruction set the compiler is allowed to use, AVX (8 lanes), SSE2 (4 lanes) or plain C++ (4 lanes)
+#if defined(__AVX__)
+#include <immintrin.h>
+#define RT_PACKET_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RT_PACKET_SSE
+#endif
+
+namespace rt{
+    // the simd wrapper lives in its own namespace so that its min/max/abs don't hide glm's inside namespace rt,
+    // calls on floatN values still find them through argument dependent lookup
+    namespace simd{
+
+    // N floats processed together, one per ray of a packet.
+    // comparisons return masks (all bits set in the lanes where the comparison is true) that can be combined with & and
+    // andNot, and turned into a bitfield with bits()
+#if defined(RT_PACKET_AVX)
+    struct floatN{
+        static const unsigned int width = 8;
+        __m256 v;
+        floatN() = default;
+        floatN(__m256 x) : v(x) {}
+        explicit floatN(float s) : v(_mm256_set1_ps(s)) {}
+        static floatN load(const float *p) { return _mm256_loadu_ps(p); }
+        void store(float *p) const { _mm256_storeu_ps(p, v); }
+        int bits() const { return _mm256_movemask_ps(v); }
+    };
+    inline floatN operator+(floatN a, floatN b) { return _mm256_add_ps(a.v, b.v); }
+    inline floatN operator-(floatN a, floatN b) { return _mm256_sub_ps(a.v, b.v); }
+    inline floatN operator*(floatN a, floatN b) { return _mm256_mul_ps(a.v, b.v); }
+    inline floatN operator/(floatN a, floatN b) { return _mm256_div_ps(a.v, b.v); }
+    inline floatN operator<(floatN a, floatN b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+    inline floatN operator>(floatN a, floatN b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+    inline floatN operator>=(floatN a, floatN b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+    inline floatN operator&(floatN a, floatN b) { return _mm256_and_ps(a.v, b.v); }
+    // a & ~b
+    inline floatN andNot(floatN a, floatN b) { return _mm256_andnot_ps(b.v, a.v); }
+    inline floatN min(floatN a, floatN b) { return _mm256_min_ps(a.v, b.v); }
+    inline floatN max(floatN a, floatN b) { return _mm256_max_ps(a.v, b.v); }
+    inline floatN abs(floatN a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+#elif defined(RT_PACKET_SSE)
+    struct floatN{
+        static const unsigned int width = 4;
+        __m128 v;
+        floatN() = default;
+        floatN(__m128 x) : v(x) {}
+        explicit floatN(float s) : v(_mm_set1_ps(s)) {}
+        static floatN load(const float *p) { return _mm_loadu_ps(p); }
+        void store(float *p) const { _mm_storeu_ps(p, v); }
+        int bits() const { return _mm_movemask_ps(v); }
+    };
+    inline floatN operator+(floatN a, floatN b) { return _mm_add_ps(a.v, b.v); }
+    inline floatN operator-(floatN a, floatN b) { return _mm_sub_ps(a.v, b.v); }
+    inline floatN operator*(floatN a, floatN b) { return _mm_mul_ps(a.v, b.v); }
+    inline floatN operator/(floatN a, floatN b) { return _mm_div_ps(a.v, b.v); }
+    inline floatN operator<(floatN a, floatN b) { return _mm_cmplt_ps(a.v, b.v); }
+    inline floatN operator>(floatN a, floatN b) { return _mm_cmpgt_ps(a.v, b.v); }
+    inline floatN operator>=(floatN a, floatN b) { return _mm_cmpge_ps(a.v, b.v); }
+    inline floatN operator&(floatN a, floatN b) { return _mm_and_ps(a.v, b.v); }
+    inline floatN andNot(floatN a, floatN b) { return _mm_andnot_ps(b.v, a.v); }
+    inline floatN min(floatN a, floatN b) { return _mm_min_ps(a.v, b.v); }
+    inline floatN max(floatN a, floatN b) { return _mm_max_ps(a.v, b.v); }
+    inline floatN abs(floatN a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+#else
+    // scalar fallback, the compiler may still vectorize the loops
+    struct floatN{
+        static const unsigned int width = 4;
+        float v[width];
+        floatN() = default;
+        explicit floatN(float s) { for (unsigned int i = 0; i < width; i++) v[i] = s; }
+        static floatN load(const float *p) { floatN r; for (unsigned int i = 0; i < width; i++) r.v[i] = p[i]; return r; }
+        void store(float *p) const { for (unsigned int i = 0; i < width; i++) p[i] = v[i]; }
+        int bits() const { int b = 0; for (unsigned int i = 0; i < width; i++) b |= (v[i] != 0 ? 1 : 0) << i; return b; }
+    };
+    // masks use 1.0f for true and 0.0f for false
+#define RT_FLOATN_OP(op, expr) \
+    inline floatN op(floatN a, floatN b) { floatN r; for (unsigned int i = 0; i < floatN::width; i++) r.v[i] = (expr); return r; }
+    RT_FLOATN_OP(operator+, a.v[i] + b.v[i])
+    RT_FLOATN_OP(operator-, a.v[i] - b.v[i])
+    RT_FLOATN_OP(operator*, a.v[i] * b.v[i])
+    RT_FLOATN_OP(operator/, a.v[i] / b.v[i])
+    RT_FLOATN_OP(operator<, a.v[i] < b.v[i] ? 1.0f : 0.0f)
+    RT_FLOATN_OP(operator>, a.v[i] > b.v[i] ? 1.0f : 0.0f)
+    RT_FLOATN_OP(operator>=, a.v[i] >= b.v[i] ? 1.0f : 0.0f)
+    RT_FLOATN_OP(operator&, a.v[i] != 0 && b.v[i] != 0 ? 1.0f : 0.0f)
+    RT_FLOATN_OP(andNot, a.v[i] != 0 && b.v[i] == 0 ? 1.0f : 0.0f)
+    RT_FLOATN_OP(min, b.v[i] < a.v[i] ? b.v[i] : a.v[i])
+    RT_FLOATN_OP(max, a.v[i] < b.v[i] ? b.v[i] : a.v[i])
+#undef RT_FLOATN_OP
+    inline floatN abs(floatN a) { for (unsigned int i = 0; i < floatN::width; i++) a.v[i] = std::fabs(a.v[i]); return a; }
+#endif
+    }
+    using simd::floatN;
+
+    // structure-of-arrays copy of the triangles of a vertex list, only what the intersection test needs:
+    // the first vertex and the two edges that leave from it. triangle i is made of vts[3i], vts[3i+1] and vts[3i+2]
+    struct TriangleSoA{
+        std::vector<float> v0x, v0y, v0z;
+        std::vector<float> e1x, e1y, e1z;
+        std::vector<float> e2x, e2y, e2z;
+
+        TriangleSoA() = default;
+        explicit TriangleSoA(const std::vector<vertex> &vts) { build(vts); }
+
+        unsigned int size() const { return (unsigned int) v0x.size(); }
+
+        void build(const std::vector<vertex> &vts){
+            unsigned int n = (unsigned int) vts.size() / 3;
+            for (auto *a : {&v0x, &v0y, &v0z, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z})
+                a->resize(n);
+            for (unsigned int i = 0; i < n; i++){
+                glm::vec3 p1 = vts[i * 3].pos;
+                glm::vec3 e1 = vts[i * 3 + 1].pos - vts[i * 3].pos;
+                glm::vec3 e2 = vts[i * 3 + 2].pos - vts[i * 3].pos;
+                v0x[i] = p1.x; v0y[i] = p1.y; v0z[i] = p1.z;
+                e1x[i] = e1.x; e1y[i] = e1.y; e1z[i] = e1.z;
+                e2x[i] = e2.x; e2y[i] = e2.y; e2z[i] = e2.z;
+            }
+        }
+    };
+
+    // floatN::width rays, stored one component per floatN. lanes that are not active are never reported as hits
+    struct RayPacket{
+        floatN ox, oy, oz;
+        floatN dx, dy, dz;
+        floatN invx, invy, invz;
+        floatN active;
+        unsigned int count;
+
+        // rays[0..count) go in the packet, count <= floatN::width
+        RayPacket(const Ray *rays, unsigned int count) : count(count) {
+            float o[3][floatN::width], d[3][floatN::width], act[floatN::width];
+            for (unsigned int i = 0; i < floatN::width; i++){
+                // unused lanes repeat the last ray so that they don't produce NaNs or extra node visits
+                const Ray &ray = rays[i < count ? i : count - 1];
+                for (int k = 0; k < 3; k++){
+                    o[k][i] = ray.origin[k];
+                    d[k][i] = ray.direction[k];
+                }
+                act[i] = i < count ? 1.0f : 0.0f;
+            }
+            ox = floatN::load(o[0]); oy = floatN::load(o[1]); oz = floatN::load(o[2]);
+            dx = floatN::load(d[0]); dy = floatN::load(d[1]); dz = floatN::load(d[2]);
+            floatN one(1.0f);
+            invx = one / dx; invy = one / dy; invz = one / dz;
+            active = floatN::load(act) > floatN(0.0f);
+        }
+    };
+
+    // tests one triangle against all the rays of the packet, same math (and the same operation order) as
+    // Renderer::rayTriangleIntersection, so a packet finds the same hits as the rays traced one at a time.
+    // tMax holds the distance of the closest hit of each ray so far and is updated, along with the hits
+    inline void packetTriangleIntersection(const RayPacket &p, const TriangleSoA &tris, unsigned int tri,
+                                           floatN &tMax, Hit *hits){
+        RT_COUNT(threadTriangleTests() += p.count);
+        floatN e1x(tris.e1x[tri]), e1y(tris.e1y[tri]), e1z(tris.e1z[tri]);
+        floatN e2x(tris.e2x[tri]), e2y(tris.e2y[tri]), e2z(tris.e2z[tri]);
+
+        // q = cross(direction, e2)
+        floatN qx = p.dy * e2z - p.dz * e2y;
+        floatN qy = p.dz * e2x - p.dx * e2z;
+        floatN qz = p.dx * e2y - p.dy * e2x;
+        floatN a = e1x * qx + e1y * qy + e1z * qz;
+
+        floatN tolerance(10e-7f);
+        floatN valid = andNot(p.active, abs(a) < tolerance);
+        if (!valid.bits()) return;
+
+        floatN f = floatN(1.0f) / a;
+        floatN sx = p.ox - floatN(tris.v0x[tri]);
+        floatN sy = p.oy - floatN(tris.v0y[tri]);
+        floatN sz = p.oz - floatN(tris.v0z[tri]);
+        floatN u = f * (sx * qx + sy * qy + sz * qz);
+        valid = andNot(valid, u < floatN(-10e-7f));
+        if (!valid.bits()) return;
+
+        // r = cross(s, e1)
+        floatN rx = sy * e1z - sz * e1y;
+        floatN ry = sz * e1x - sx * e1z;
+        floatN rz = sx * e1y - sy * e1x;
+        floatN v = f * (p.dx * rx + p.dy * ry + p.dz * rz);
+        valid = andNot(andNot(valid, v < floatN(-10e-7f)), u + v > floatN(1.0f));
+
+        floatN t = f * (e2x * rx + e2y * ry + e2z * rz);
+        valid = andNot(valid, t < floatN(0.0f)) & (t < tMax);
+
+        int mask = valid.bits();
+        if (!mask) return;
+
+        // hits are rare compared to tests, so we update them one lane at a time
+        float tl[floatN::width], ul[floatN::width], vl[floatN::width], tm[floatN::width];
+        t.store(tl); u.store(ul); v.store(vl); tMax.store(tm);
+        for (unsigned int i = 0; i < floatN::width; i++){
+            if (!(mask & (1 << i))) continue;
+            tm[i] = tl[i];
+            hits[i].hit_ID = (int) tri * 3;
+            hits[i].dist = tl[i];
+            hits[i].barycentric = glm::vec3(1.0f - ul[i] - vl[i], ul[i], vl[i]);
+        }
+        tMax = floatN::load(tm);
+    }
+
+    // slab test of all rays of the packet against a box, returns the mask of the rays that enter it before their tMax
+    inline floatN packetBoxIntersection(const RayPacket &p, const AABB &box, const floatN &tMax, floatN &tNear){
+        floatN t0x = (floatN(box.min.x) - p.ox) * p.invx, t1x = (floatN(box.max.x) - p.ox) * p.invx;
+        floatN t0y = (floatN(box.min.y) - p.oy) * p.invy, t1y = (floatN(box.max.y) - p.oy) * p.invy;
+        floatN t0z = (floatN(box.min.z) - p.oz) * p.invz, t1z = (floatN(box.max.z) - p.oz) * p.invz;
+        tNear = max(max(min(t0x, t1x), min(t0y, t1y)), min(t0z, t1z));
+        floatN tFar = min(min(max(t0x, t1x), max(t0y, t1y)), max(t0z, t1z));
+        return (tFar >= tNear) & (tFar >= floatN(0.0f)) & (tMax > tNear) & p.active;
+    }
+
+    // closest hit of every ray of the packet, hits[i] must start as a default Hit.
+    // the packet goes down the hierarchy together: a node is visited if any of its rays enters it
+    inline void packetClosestHit(const RayPacket &p, const BVH *bvh, const TriangleSoA &tris, Hit *hits){
+        floatN tMax(FLT_MAX);
+
+        if (!bvh || bvh->empty()) {
+            for (unsigned int tri = 0; tri < tris.size(); tri++)
+                packetTriangleIntersection(p, tris, tri, tMax, hits);
+            return;
+        }
+
+        const std::vector<BVHNode> &nodes = bvh->nodes;
+        // both children can be pushed at every level, so twice the depth of the tree
+        unsigned int stack[128];
+        unsigned int stackSize = 0;
+        floatN tNear;
+        if (!packetBoxIntersection(p, nodes[0].bounds, tMax, tNear).bits()) return;
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const BVHNode &node = nodes[stack[--stackSize]];
+            if (node.isLeaf()) {
+                for (unsigned int i = 0; i < node.count; i++)
+                    packetTriangleIntersection(p, tris, bvh->indices[node.leftFirst + i], tMax, hits);
+                continue;
+            }
+
+            unsigned int first = node.leftFirst, second = node.leftFirst + 1;
+            floatN tFirst, tSecond;
+            int hitFirst = packetBoxIntersection(p, nodes[first].bounds, tMax, tFirst).bits();
+            int hitSecond = packetBoxIntersection(p, nodes[second].bounds, tMax, tSecond).bits();
+
+            // closest child first, judging by the first ray that enters it
+            if (hitFirst && hitSecond) {
+                float nearFirst[floatN::width], nearSecond[floatN::width];
+                tFirst.store(nearFirst);
+                tSecond.store(nearSecond);
+                unsigned int lane = 0;
+                while (!((hitFirst & hitSecond) & (1 << lane)) && lane < floatN::width - 1) lane++;
+                if (nearSecond[lane] < nearFirst[lane]) std::swap(first, second);
+                stack[stackSize++] = second;
+                stack[stackSize++] = first;
+            }
+            else if (hitFirst) stack[stackSize++] = first;
+            else if (hitSecond) stack[stackSize++] = second;
+        }
+    }
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_PACKET_H
@@ -6,47 +6,192 @@
 #define ITU_GRAPHICS_PROGRAMMING_RT_RENDERER_H
 
 #include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include "rt_types.h"
+#include "rt_bvh.h"
+#include "rt_tile_pool.h"
+#include "rt_packet.h"
+#include "rt_color.h"
+#include "rt_scene.h"
 #include "frame_buffer.h"
 
 namespace rt{
     using namespace Colors;
     using namespace glm;
 
+    // the camera sensor placed in the space of the model, used to generate the primary rays
+    struct ImagePlane{
+        // the transformation that move points from camera space to model space
+        mat4 view_to_model;
+        // the bottom left corner of the image plane/camera sensor
+        vec4 lower_left_corner;
+        // the camera position (also the convergence point of light rays) in MODEL coordinates
+        vec4 cam_pos;
+        // the distance from the center of one pixel to the next along the horizontal and vertical axes of the screen
+        vec2 pixel_size;
+
+        template<class T>
+            // width over height, as floats
+            // width over height, as floats: the integer division gave 0 (or 1) for anything but square images
+            float aspect_ratio = float(fb.W) / float(fb.H);
+            // we use the fov and the tangent function to compute where is the bottom of the projection plane,
+            // we assume that the projection place is 1 unit in front of the camera (z == -1)
+            float bottom = - tan(abs(radians(fov_degrees)) * 0.5f);
+
+            view_to_model = inverse(v * m);
+            lower_left_corner = vec4(bottom * aspect_ratio, bottom, -1, 1);
+            // notice that we implicitly assume that the camera position is at 0,0,0 in its one coordinate space
+            cam_pos = view_to_model * vec4(0,0,0,1);
+            // notice that * and / are applied component wise
+            pixel_size = abs(vec2(lower_left_corner)) * 2.0f / vec2(fb.W, fb.H);
+        }
+
+        // the ray that goes from the camera through the point (x, y) of the image, in pixel units
+        Ray rayThrough(float x, float y) const{
+            vec4 pixel_pos = lower_left_corner + vec4 (vec2(x, y) * pixel_size,0, 0);
+            pixel_pos = view_to_model * pixel_pos;  // transform from camera coord space to model coord space
+            return Ray(cam_pos, normalize(pixel_pos - cam_pos));
+        }
+    };
+
     class Renderer{
-        // limits the number of reflections, 1 == no reflection
-        const unsigned int max_recursion = 5;
+        // limits the number of reflections, 1 == no reflection. with the default min_throughput and p_rg, reflections
+        // usually stop being traced well before this
+        static const unsigned int max_recursion = 16;
         // mixture parameter for combining local illumination and reflected color
         float p_rg = 0.4f;
+        // reflected rays whose contribution to the pixel (p_rg^bounces) is below this are not traced, see setMinThroughput
+        float min_throughput = 1.0f / 256.0f;
+        // optional acceleration structure, must have been built over the same vertex list passed to render
+        const BVH *bvh = nullptr;
+        // optional intersection-only copy of the triangles, must have been made from the vertex list passed to render
+        const std::vector<triangle> *compact_triangles = nullptr;
+        // optional structure-of-arrays copy of the triangles, used to trace the primary rays in packets
+        const TriangleSoA *packet_triangles = nullptr;
+        // parallel rendering settings, see setThreadCount and setTileSize
+        unsigned int thread_count = 1;
+        unsigned int tile_size = 16;
+        // how the float colors are written to the frame buffer, see setColorConversion
+        Conversion color_conversion;
+        // adaptive anti-aliasing settings, see setAdaptiveSampling
+        unsigned int aa_grid = 0;
+        float aa_contrast = 1.0f / 16.0f;
+        // colors of the one ray per pixel pass of adaptive anti-aliasing, row after row
+        std::vector<color> first_samples;
+
+        // progressive rendering settings, see renderProgressive
+        unsigned int coarse_block = 4;
+        unsigned int max_progressive_passes = 64;
+
+        // what renderProgressive keeps from one call to the next
+        struct Progressive{
+            // running average of the samples of each pixel
+            std::vector<color> accumulation;
+            // refinement passes done so far, and the first row not yet refined in the current pass
+            unsigned int pass = 0;
+            unsigned int row = 0;
+            // everything the image depends on, when any of it changes we start over
+            const std::vector<vertex> *vts = nullptr;
+            size_t vertexCount = 0;
+            mat4 m, v;
+            float fov_degrees = 0;
+            unsigned int depth = 0, W = 0, H = 0;
+
+            bool changed(const std::vector<vertex> &vts_, const mat4 &m_, const mat4 &v_, float fov_,
+                         unsigned int depth_, unsigned int W_, unsigned int H_) const{
+                return vts != &vts_ || vertexCount != vts_.size() || m != m_ || v != v_ || fov_degrees != fov_ ||
+                       depth != depth_ || W != W_ || H != H_;
+            }
 
-    public:
-        void render(const std::vector<vertex> &vts,
-                    const glm::mat4 &m,
-                    const glm::mat4 &v,
-                    const float fov_degrees,
-                    unsigned int depth,
-                    FrameBuffer <uint32_t> &fb) {
+            void reset(const std::vector<vertex> &vts_, const mat4 &m_, const mat4 &v_, float fov_,
+                       unsigned int depth_, unsigned int W_, unsigned int H_){
+                vts = &vts_; vertexCount = vts_.size(); m = m_; v = v_; fov_degrees = fov_;
+                depth = depth_; W = W_; H = H_;
+                accumulation.assign(W * H, black);
+                pass = 0;
+                row = 0;
+            }
+        } progressive;
+
+        // a reflected ray waiting to be traced, throughput is the weight of its color in the pixel
+        struct QueuedRay{
+            Ray ray;
+            float throughput;
+            unsigned int depth;
+        };
+
+        // float colors of the tile being rendered by this thread, row after row, converted to the frame buffer all
+        // at once when the tile is done
+        static std::vector<color> &tileColors(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1){
+            static thread_local std::vector<color> colors;
+            colors.resize(size_t(x1 - x0) * (y1 - y0));
+            return colors;
+        }
 
-            float aspect_ratio = fb.H / fb.W;
-            // we use the fov and the tangent function to compute where is the bottom of the projection plane,
-            // we assume that the projection place is 1 unit in front of the camera (z == -1)
-            float bottom = - tan(abs(radians(fov_degrees)) * 0.5f);
+        // pseudo random offset in [0, 1)^2 for a pixel and a sample, the same inputs always give the same offset
+        static vec2 pixelJitter(unsigned int x, unsigned int y, unsigned int sample){
+            // pcg hash, see "Hash Functions for GPU Rendering" (Jarzynski and Olano, 2020)
+            auto pcg = [](uint32_t v){
+                uint32_t state = v * 747796405u + 2891336453u;
+                uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+                return (word >> 22u) ^ word;
+            };
+            uint32_t h = pcg(x + pcg(y + pcg(sample)));
+            // 24 bits are all a float in [0, 1) can hold
+            return vec2((h >> 8) * (1.0f / 16777216.0f), (pcg(h) >> 8) * (1.0f / 16777216.0f));
+        }
 
-            // find the transformation that move points from camera space to model space
-            mat4 view_to_model = inverse(v * m);
-            // the bottom left corner of the image plane/camera sensor
-            vec4 lower_left_corner = vec4(bottom * aspect_ratio, bottom, -1, 1);
-            // we transform the camera position (also the convergence point of light rays) from camera coordinates to MODEL coordinates
-            // notice that we implicitly assume that the camera position is at 0,0,0 in its one coordinate space
-            vec4 cam_pos = view_to_model * vec4(0,0,0,1);
+        template<class TileFn>
+        static void runTile(TileFn &tileFn, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, RayStats &rayStats){
+            // the triangle tests of the tile are counted by the thread, see threadTriangleTests
+            RT_COUNT(threadTriangleTests() = 0);
+            tileFn(x0, y0, x1, y1, rayStats);
+            RT_COUNT(rayStats.triangleTests += threadTriangleTests());
+        }
 
-            // the distance from the center of one pixel to the next along the horizontal and vertical axes of the screen
-            // notice that * and / are applied component wise
-            vec2 pixel_size = abs(vec2(lower_left_corner)) * 2.0f / vec2(fb.H, fb.W);
+        // splits [x0, x1) x [y0, y1) in tiles and calls tileFn(tileX0, tileY0, tileX1, tileY1, rayStats) for each of
+        // them on thread_count threads. each worker gets whole tiles and should write only the pixels of the tiles it
+        // got, so no synchronization is needed on the frame buffer. the ray counts of all workers are added to stats
+        template<class TileFn>
+        void forEachTile(unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, TileFn tileFn){
+            unsigned int workers = thread_count > 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency());
+            if (workers == 1) {
+                runTile(tileFn, x0, y0, x1, y1, stats);
+                return;
+            }
 
+            unsigned int tilesX = (x1 - x0 + tile_size - 1) / tile_size;
+            unsigned int tilesY = (y1 - y0 + tile_size - 1) / tile_size;
+            TilePool pool(tilesX * tilesY, workers);
+            std::vector<RayStats> workerStats(workers);
+            std::vector<std::thread> threads;
+            for (unsigned int w = 0; w < workers; w++) {
+                threads.emplace_back([&, w](){
+                    unsigned int tile;
+                    while (pool.next(w, tile)) {
+                        unsigned int tx = x0 + (tile % tilesX) * tile_size;
+                        unsigned int ty = y0 + (tile / tilesX) * tile_size;
+                        runTile(tileFn, tx, ty, std::min(tx + tile_size, x1), std::min(ty + tile_size, y1), workerStats[w]);
+                    }
+                });
+            }
+            for (auto &thread : threads) thread.join();
+            for (auto &s : workerStats) stats += s;
+        }
 
+        // renders the pixels in [x0, x1) x [y0, y1). dst is the color of pixel (x0, y0), the next rows of the tile start
+        // stride colors after each other. geometry is a flat vertex list or a Scene
+        template<class Geometry>
+        void renderTile(const ImagePlane &plane,
+                        unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+                        const Geometry &geometry,
+                        unsigned int depth,
+                        color *dst, size_t stride,
+                        RayStats &rayStats){
             // TODO ex 11.1 iterate through all pixels in the buffer (width: [0, fb.W), height:[0, fb.H])
             //  for each pixel,
             //  - find its position in the space of the camera,
@@ -56,34 +201,335 @@ namespace rt{
             //  all intersection computations should happen in the same space, no matter what that space is)
             //  - create a ray with the camera origin, and the vector from the camera origin to the pixel you have just found
             //  - call the TraceRay method using that ray, and store the resulting color in the frame buffer (fb)
-            for (int c = 0; c < fb.W; c++){
-                for(int r = 0; r < fb.H; r++){
-                    vec4 pixel_pos = lower_left_corner + vec4 (vec2(c, r) * pixel_size,0, 0);
-                    pixel_pos = view_to_model * pixel_pos;  // transform from camera coord space to model coord space
-                    Ray ray(cam_pos, normalize(pixel_pos - cam_pos));
-                    color col = traceRay(ray, depth, vts);  // trace te ray / compute the color
-                    fb.paintAt(c, r, toRGBA32(col));        // set the color on the frame buffer
+            if (usePackets(geometry)) {
+                renderTilePackets(plane, x0, y0, x1, y1, geometry, depth, dst, stride, rayStats);
+                return;
+            }
+            for (unsigned int c = x0; c < x1; c++){
+                for(unsigned int r = y0; r < y1; r++){
+                    Ray ray = plane.rayThrough(c, r);
+                    rayStats.primary++;
+                    color col = traceRay(ray, depth, geometry, rayStats);  // trace te ray / compute the color
+                    dst[(c - x0) + (r - y0) * stride] = col;
+                }
+            }
+        }
+
+        // same as renderTile, but the primary rays of neighbouring pixels (in the same column) are intersected together,
+        // as a packet, and only the shading is done one pixel at a time. only called when usePackets(geometry)
+        template<class Geometry>
+        void renderTilePackets(const ImagePlane &plane,
+                               unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1,
+                               const Geometry &geometry,
+                               unsigned int depth,
+                               color *dst, size_t stride,
+                               RayStats &rayStats){
+            const unsigned int width = floatN::width;
+            for (unsigned int c = x0; c < x1; c++){
+                for(unsigned int r = y0; r < y1; r += width){
+                    unsigned int count = std::min(width, y1 - r);
+                    Ray rays[width] = {};
+                    Hit hits[width];
+                    for (unsigned int i = 0; i < count; i++)
+                        rays[i] = plane.rayThrough(c, r + i);
+                    packetClosestHit(RayPacket(rays, count), bvh, *packet_triangles, hits);
+
+                    for (unsigned int i = 0; i < count; i++){
+                        rayStats.primary++;
+                        RT_COUNT(rayStats.countRay(0, hits[i].hit_ID >= 0));
+                        color col = hits[i].hit_ID < 0 ? black : shade(rays[i], hits[i], depth, geometry, rayStats);
+                        dst[(c - x0) + (r + i - y0) * stride] = col;
+                    }
+                }
+            }
+        }
+
+        // largest difference, in r, g or b, between the first sample of pixel (x, y) and those of its 4 neighbours
+        float localContrast(unsigned int x, unsigned int y, unsigned int W, unsigned int H) const{
+            color center = clamp(first_samples[x + size_t(y) * W], 0.0f, 1.0f);
+            float contrast = 0;
+            auto compare = [&](unsigned int nx, unsigned int ny){
+                vec3 diff = abs(vec3(clamp(first_samples[nx + size_t(ny) * W], 0.0f, 1.0f) - center));
+                contrast = std::max(contrast, std::max(diff.r, std::max(diff.g, diff.b)));
+            };
+            if (x > 0) compare(x - 1, y);
+            if (x + 1 < W) compare(x + 1, y);
+            if (y > 0) compare(x, y - 1);
+            if (y + 1 < H) compare(x, y + 1);
+            return contrast;
+        }
+
+        // average of aa_grid x aa_grid samples of pixel (x, y), one at a random point of each cell of a grid over the
+        // pixel. the pixel is the square of side 1 centered at the point render traces, so refined and plain pixels
+        // line up
+        template<class Geometry>
+        color supersample(const ImagePlane &plane, unsigned int x, unsigned int y, const Geometry &geometry,
+                          unsigned int depth, RayStats &rayStats){
+            color sum(0);
+            float cell = 1.0f / aa_grid;
+            for (unsigned int j = 0; j < aa_grid; j++){
+                for (unsigned int i = 0; i < aa_grid; i++){
+                    vec2 jitter = pixelJitter(x, y, i + j * aa_grid);
+                    rayStats.primary++;
+                    sum += traceRay(plane.rayThrough(x - .5f + (i + jitter.x) * cell, y - .5f + (j + jitter.y) * cell),
+                                    depth, geometry, rayStats);
+                }
+            }
+            rayStats.supersampled++;
+            return sum / float(aa_grid * aa_grid);
+        }
+
+        // the packet triangles are a copy of a flat vertex list, they can't be used with a Scene. the packets are
+        // traversed with the BVH, so it must have been built over the same triangles (see closestHit)
+        bool usePackets(const std::vector<vertex> &vts) const{
+            return packet_triangles && packet_triangles->size() == vts.size() / 3 &&
+                   bvh && bvh->primitiveCount() == vts.size() / 3;
+        }
+        bool usePackets(const Scene &) const{
+            return false;
+        }
+
+        // what render does once it knows where the rays start
+        template<class Geometry>
+        void renderImage(const ImagePlane &plane,
+                         const Geometry &geometry,
+                         unsigned int depth,
+                         FrameBuffer <uint32_t> &fb) {
+            stats = RayStats();
+            if (aa_grid < 2) {
+                forEachTile(0, 0, fb.W, fb.H, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, RayStats &rayStats){
+                    std::vector<color> &colors = tileColors(x0, y0, x1, y1);
+                    renderTile(plane, x0, y0, x1, y1, geometry, depth, colors.data(), x1 - x0, rayStats);
+                    // set the colors on the frame buffer (the tile is inside it)
+                    toRGBA32(colors.data(), x0, y0, x1, y1, fb, color_conversion);
+                });
+                return;
+            }
+
+            // adaptive anti-aliasing, first one ray per pixel for the whole image, so that every tile of the second
+            // pass can look at the pixels around it
+            first_samples.resize(size_t(fb.W) * fb.H);
+            forEachTile(0, 0, fb.W, fb.H, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, RayStats &rayStats){
+                renderTile(plane, x0, y0, x1, y1, geometry, depth, first_samples.data() + x0 + size_t(y0) * fb.W, fb.W, rayStats);
+            });
+            forEachTile(0, 0, fb.W, fb.H, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, RayStats &rayStats){
+                std::vector<color> &colors = tileColors(x0, y0, x1, y1);
+                for (unsigned int r = y0; r < y1; r++){
+                    for (unsigned int c = x0; c < x1; c++){
+                        colors[(c - x0) + (r - y0) * (x1 - x0)] = localContrast(c, r, fb.W, fb.H) > aa_contrast ?
+                                supersample(plane, c, r, geometry, depth, rayStats) : first_samples[c + size_t(r) * fb.W];
+                    }
+                }
+                toRGBA32(colors.data(), x0, y0, x1, y1, fb, color_conversion);
+            });
+        }
+
+    public:
+        // rays traced during the last call to render
+        RayStats stats;
+
+        // use the hierarchy for every ray (primary, shadow and reflection), nullptr goes back to testing every triangle
+        void setAccelerationStructure(const BVH *accel){
+            bvh = accel;
+        }
+
+        // intersect rays with this compact copy of the triangles (see makeTriangles), the vertices are then only read
+        // to shade the closest hit. nullptr goes back to intersecting the vertex list directly
+        void setCompactTriangles(const std::vector<triangle> *triangles){
+            compact_triangles = triangles;
+        }
+
+        // trace primary rays in packets of floatN::width rays using this copy of the triangles (which must have been
+        // built from the vertex list passed to render), nullptr traces them one at a time
+        void setPacketTriangles(const TriangleSoA *triangles){
+            packet_triangles = triangles;
+        }
+
+        // number of threads used by render, 0 uses one thread per hardware core, 1 renders on the calling thread
+        void setThreadCount(unsigned int count){
+            thread_count = count;
+        }
+
+        // side, in pixels, of the square tiles handed out to the render threads
+        void setTileSize(unsigned int size){
+            tile_size = size > 0 ? size : 1;
+        }
+
+        // reflections stop once their weight in the pixel color falls below this, even if depth allows more bounces.
+        // the default, 1/256, stops before a bounce could change an 8 bit color channel by more than about one step,
+        // 0 always traces depth bounces
+        void setMinThroughput(float throughput){
+            min_throughput = throughput;
+        }
+
+        // sRGB encoding and/or ordered dithering of the colors written by render and renderProgressive. the default,
+        // neither, gives the same values as toRGBA32(color)
+        void setColorConversion(Conversion conversion){
+            color_conversion = conversion;
+        }
+
+        // adaptive anti-aliasing for render. after tracing one ray per pixel, the pixels whose color differs from that
+        // of one of their 4 neighbours by more than contrast (in r, g or b, colors in [0, 1]) are traced again with
+        // grid x grid stratified samples. edges get grid^2 samples and flat areas one. grid 0 or 1 turns it off
+        void setAdaptiveSampling(unsigned int grid, float contrast = 1.0f / 16.0f){
+            aa_grid = grid;
+            aa_contrast = contrast;
+        }
+
+        void render(const std::vector<vertex> &vts,
+                    const glm::mat4 &m,
+                    const glm::mat4 &v,
+                    const float fov_degrees,
+                    unsigned int depth,
+                    FrameBuffer <uint32_t> &fb) {
+
+            ImagePlane plane(m, v, fov_degrees, fb);
+            renderImage(plane, vts, depth, fb);
+        }
+
+        // renders the instances of a scene, seen with the view matrix v. the scene must have been built (Scene::build)
+        void render(const Scene &scene,
+                    const glm::mat4 &v,
+                    const float fov_degrees,
+                    unsigned int depth,
+                    FrameBuffer <uint32_t> &fb) {
+            // the rays start in the space of the scene, each instance moves them to the space of its mesh
+            ImagePlane plane(glm::mat4(1), v, fov_degrees, fb);
+            renderImage(plane, scene, depth, fb);
+        }
+
+        // progressive version of render, meant to be called every frame. the first call after the camera (or anything
+        // else that changes the image) moves renders a coarse image, one ray per coarse_block x coarse_block pixels.
+        // the calls after that refine it, adding one jittered sample per pixel and pass to a running average, and stop
+        // working on a pass once time_budget seconds have gone by, so a single call never takes (much) longer than that.
+        // returns true once max_progressive_passes have been accumulated and there is nothing left to refine
+        bool renderProgressive(const std::vector<vertex> &vts,
+                               const glm::mat4 &m,
+                               const glm::mat4 &v,
+                               const float fov_degrees,
+                               unsigned int depth,
+                               FrameBuffer <uint32_t> &fb,
+                               float time_budget) {
+            auto start = std::chrono::high_resolution_clock::now();
+            ImagePlane plane(m, v, fov_degrees, fb);
+            stats = RayStats();
+
+            Progressive &p = progressive;
+            if (p.changed(vts, m, v, fov_degrees, depth, fb.W, fb.H)) {
+                p.reset(vts, m, v, fov_degrees, depth, fb.W, fb.H);
+
+                // coarse pass, the color of the first pixel of each block is used for the whole block
+                forEachTile(0, 0, fb.W, fb.H, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, RayStats &rayStats){
+                    for (unsigned int c = x0; c < x1; c++){
+                        for (unsigned int r = y0; r < y1; r++){
+                            if (c % coarse_block != 0 || r % coarse_block != 0) continue;
+                            rayStats.primary++;
+                            color col = traceRay(plane.rayThrough(c, r), depth, vts, rayStats);
+                            for (unsigned int bc = c; bc < std::min(c + coarse_block, fb.W); bc++)
+                                for (unsigned int br = r; br < std::min(r + coarse_block, fb.H); br++)
+                                    p.accumulation[bc + br * fb.W] = col;
+                        }
+                    }
+                });
+            }
+            else {
+                // refinement passes, done in bands of rows until we run out of time
+                while (p.pass < max_progressive_passes) {
+                    unsigned int rowEnd = std::min(p.row + tile_size, fb.H);
+                    unsigned int pass = p.pass;
+                    forEachTile(0, p.row, fb.W, rowEnd, [&](unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, RayStats &rayStats){
+                        for (unsigned int c = x0; c < x1; c++){
+                            for (unsigned int r = y0; r < y1; r++){
+                                // the first pass goes through the same point as render does, the next ones are jittered
+                                vec2 jitter = pass == 0 ? vec2(0) : pixelJitter(c, r, pass);
+                                rayStats.primary++;
+                                color col = traceRay(plane.rayThrough(c + jitter.x, r + jitter.y), depth, vts, rayStats);
+                                color &acc = p.accumulation[c + r * fb.W];
+                                // running average, the coarse color is simply replaced by the first sample
+                                acc += (col - acc) / float(pass + 1);
+                            }
+                        }
+                    });
+
+                    p.row = rowEnd;
+                    if (p.row == fb.H) {
+                        p.row = 0;
+                        p.pass++;
+                    }
+                    std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now() - start;
+                    if (elapsed.count() >= time_budget) break;
                 }
             }
 
+            // the accumulation buffer is row after row, as the whole image, so it is converted in one go
+            toRGBA32(p.accumulation.data(), 0, 0, fb.W, fb.H, fb, color_conversion);
+
+            return p.pass >= max_progressive_passes;
         }
 
+        // number of refinement passes renderProgressive has completed since the image was last reset
+        unsigned int progressivePasses() const{
+            return progressive.pass;
+        }
 
+
+        // geometry is a flat vertex list or a Scene
+        template<class Geometry>
         color traceRay(const Ray & ray,
                        unsigned int depth,
-                       const std::vector<vertex> &vts){
-            // this is here to ensure we don't end up with a long recursion that can freeze the program (or cause a stack overflow)
+                       const Geometry &geometry,
+                       RayStats &rayStats){
+            Hit hitInfo; // used to store the hit information
+            bool hit = closestHit(ray, geometry, hitInfo);
+            RT_COUNT(rayStats.countRay(0, hit));
+            if (!hit) return black; // no hit, return black
+            return shade(ray, hitInfo, depth, geometry, rayStats);
+        }
+
+        // color at the point where the ray hit the model, including its reflections.
+        // reflections are not traced recursively, each hit queues its reflected ray with the weight the ray's color has
+        // in the pixel, and the queue is emptied here. the weight shrinks by p_rg at every bounce, so we stop bouncing
+        // once it is too small to matter instead of always going depth levels deep
+        template<class Geometry>
+        color shade(const Ray & ray,
+                    const Hit & hitInfo,
+                    unsigned int depth,
+                    const Geometry &geometry,
+                    RayStats &rayStats){
+            // this is here to ensure we don't end up with a long chain of reflections that can freeze the program
             depth = depth > max_recursion ? max_recursion : depth;
 
-            color col = black; // used to output a color
-            Hit hitInfo; // used to store the hit information
-            if (!rayModelIntersection(ray, vts, hitInfo)) return col; // no hit, return black
+            // every hit queues at most one ray, and it is traced before the next hit, so this never overflows
+            QueuedRay queue[max_recursion];
+            unsigned int queued = 0;
+
+            color col = shadeHit(QueuedRay{ray, 1.0f, depth}, hitInfo, geometry, queue, queued, rayStats);
+            while (queued > 0) {
+                QueuedRay next = queue[--queued];
+                Hit hit;
+                bool found = closestHit(next.ray, geometry, hit);
+                RT_COUNT(rayStats.countRay(depth - next.depth, found));
+                if (found)
+                    col += shadeHit(next, hit, geometry, queue, queued, rayStats);
+            }
+            return col;
+        }
 
+        // local illumination at a hit, weighted by the throughput of the ray, and queues the reflected ray if it
+        // can still contribute to the pixel
+        template<class Geometry>
+        color shadeHit(const QueuedRay & queuedRay,
+                       const Hit & hitInfo,
+                       const Geometry &geometry,
+                       QueuedRay *queue,
+                       unsigned int &queued,
+                       RayStats &rayStats){
+            const Ray &ray = queuedRay.ray;
+            color col = black; // used to output a color
 
-            // TODO ex 11.2 replace the current i_normal and i_col computation with their interpolated versions
-            vec3 i_normal = vts[hitInfo.hit_ID].norm * hitInfo.barycentric.x + vts[hitInfo.hit_ID+1].norm * hitInfo.barycentric.y + vts[hitInfo.hit_ID+2].norm * hitInfo.barycentric.z;
-            i_normal = normalize(i_normal);
-            color i_col = vts[hitInfo.hit_ID].col * hitInfo.barycentric.x + vts[hitInfo.hit_ID+1].col * hitInfo.barycentric.y + vts[hitInfo.hit_ID+2].col * hitInfo.barycentric.z;
+            vec3 i_normal;
+            color i_col;
+            surfaceAt(hitInfo, geometry, i_normal, i_col);
 
             vec3 i_pos = ray.origin + ray.direction * hitInfo.dist;
 
@@ -97,23 +543,201 @@ namespace rt{
             // TODO ex 11.4 check if the light source is visible from i_pos, we only use the diffuse and specular components if that is the case
             Ray shadow_ray(i_pos + i_normal * .001f, light_dir); // i_normal * .001f is handling numerical precision issues, it prevents self-intersection
             float light_dist = length(light_pos - i_pos);
-            Hit shadow_hit;
-            // check if there is geometry in the direction of the light, and if the closest geometry is closer than the light source
-            if (rayModelIntersection(shadow_ray, vts, shadow_hit) && light_dist < shadow_hit.dist) {
+            rayStats.shadow++;
+            // check if there is geometry in the direction of the light that is closer than the light source, any
+            // such geometry will do, we don't need to know which one is the closest
+            bool in_shadow = occluded(shadow_ray, light_dist, geometry);
+            RT_COUNT(rayStats.occluded += in_shadow);
+            if (!in_shadow) {
                 // the light is visible from i_pos (there is no occlusion), so we compute direct lighting
                 col += diffuse * i_col * max(dot(light_dir, i_normal), .0f) +
                        specular * pow(max(dot(light_dir, i_normal), .0f), shininess);
             }
 
-            // the recursion/reflection happens here!
-            if (depth > 1) {
+            // the reflection happens here! it is traced later by shade, with its color scaled by a p_rg factor
+            float reflected_throughput = queuedRay.throughput * p_rg;
+            if (queuedRay.depth > 1 && reflected_throughput >= min_throughput) {
                 Ray reflected_ray(i_pos, reflect(ray.direction, i_normal));
                 reflected_ray.origin -= ray.direction * .001f; // this is a small offset to address numerical precision issues
-                // integrate the current color with the reflection color by a p_rg factor
-                col += p_rg * traceRay(reflected_ray, depth - 1, vts);
+                rayStats.secondary++;
+                queue[queued++] = QueuedRay{reflected_ray, reflected_throughput, queuedRay.depth - 1};
             }
 
-            return col;
+            return queuedRay.throughput * col;
+        }
+
+        // normal (normalized) and color of the surface at a hit
+        static void surfaceAt(const Hit & hitInfo,
+                              const std::vector<vertex> &vts,
+                              vec3 &i_normal, color &i_col){
+            // TODO ex 11.2 replace the current i_normal and i_col computation with their interpolated versions
+            i_normal = vts[hitInfo.hit_ID].norm * hitInfo.barycentric.x + vts[hitInfo.hit_ID+1].norm * hitInfo.barycentric.y + vts[hitInfo.hit_ID+2].norm * hitInfo.barycentric.z;
+            i_normal = normalize(i_normal);
+            i_col = vts[hitInfo.hit_ID].col * hitInfo.barycentric.x + vts[hitInfo.hit_ID+1].col * hitInfo.barycentric.y + vts[hitInfo.hit_ID+2].col * hitInfo.barycentric.z;
+        }
+
+        // same for a scene, the normal of the mesh is moved to the space of the scene
+        static void surfaceAt(const Hit & hitInfo,
+                              const Scene &scene,
+                              vec3 &i_normal, color &i_col){
+            const Instance &instance = scene.instance(hitInfo.instance_ID);
+            surfaceAt(hitInfo, scene.mesh(instance.mesh).vertices, i_normal, i_col);
+            i_normal = normalize(instance.normal_matrix * i_normal);
+        }
+
+        // the ray moved to the space of an instance. the direction is not normalized, so that distances along the
+        // moved ray are the same as along the original one, and hits can be compared across instances
+        static Ray toInstance(const Ray & ray, const Instance &instance){
+            return Ray(vec3(instance.world_to_model * vec4(ray.origin, 1)), vec3(instance.world_to_model * vec4(ray.direction, 0)));
+        }
+
+        // closest hit in a scene, hit.instance_ID tells which instance was hit and hit.hit_ID is the index of the first
+        // vertex of the triangle in the vertices of its mesh
+        bool closestHit(const Ray & ray,
+                        const Scene &scene,
+                        Hit &hit) const{
+            scene.topLevel().traverse(ray, hit.dist, [&](unsigned int inst, float &tMax){
+                const Instance &instance = scene.instance(inst);
+                const Mesh &mesh = scene.mesh(instance.mesh);
+                Ray local = toInstance(ray, instance);
+                // tMax is shared by both levels, a hit in this instance also culls the instances behind it
+                mesh.bvh.traverse(local, tMax, [&](unsigned int tri, float &t){
+                    float dist_temp;
+                    vec3 barycentric_temp;
+                    if (rayTriangleIntersection(local, mesh.triangles[tri], dist_temp, barycentric_temp) && dist_temp < t)
+                    {
+                        hit.hit_ID = (int) tri * 3;
+                        hit.instance_ID = (int) inst;
+                        hit.barycentric = barycentric_temp;
+                        t = dist_temp; // t is hit.dist
+                    }
+                    return false;
+                });
+                return false; // a closer hit can still be in another instance
+            });
+            return hit.hit_ID < 0 ? false : true;
+        }
+
+        // true if any instance of the scene has a triangle closer than tMax along the ray
+        bool occluded(const Ray & ray,
+                      float tMax,
+                      const Scene &scene) const{
+            bool blocked = false;
+            float range = tMax;
+            scene.topLevel().traverse(ray, range, [&](unsigned int inst, float &){
+                const Instance &instance = scene.instance(inst);
+                const Mesh &mesh = scene.mesh(instance.mesh);
+                Ray local = toInstance(ray, instance);
+                float localRange = tMax;
+                mesh.bvh.traverse(local, localRange, [&](unsigned int tri, float &){
+                    float dist_temp;
+                    vec3 barycentric_temp;
+                    blocked = rayTriangleIntersection(local, mesh.triangles[tri], dist_temp, barycentric_temp) && dist_temp < tMax;
+                    return blocked;
+                });
+                return blocked;
+            });
+            return blocked;
+        }
+
+        // returns false if no intersection, uses the acceleration structure if there is one for this vertex list
+        // intersection results are returned in the "hit" reference variable
+        bool closestHit(const Ray & ray,
+                        const std::vector<vertex> &vts,
+                        Hit &hit) const{
+            // the compact triangles only hold positions, the vertices are only read for the closest hit, when shading
+            const std::vector<triangle> *tris = compact_triangles && compact_triangles->size() == vts.size() / 3 ?
+                                                compact_triangles : nullptr;
+
+            if (!bvh || bvh->primitiveCount() != vts.size() / 3)
+                return tris ? rayModelIntersection(ray, *tris, hit) : rayModelIntersection(ray, vts, hit);
+
+            bvh->traverse(ray, hit.dist, [&](unsigned int tri, float &tMax){
+                unsigned int i = tri * 3;
+                float dist_temp;
+                vec3 barycentric_temp;
+                bool intersects = tris ? rayTriangleIntersection(ray, (*tris)[tri], dist_temp, barycentric_temp) :
+                                  rayTriangleIntersection(ray, vts[i], vts[i+1], vts[i+2], dist_temp, barycentric_temp);
+                if (intersects && dist_temp < tMax)
+                {
+                    hit.hit_ID = i;
+                    hit.barycentric = barycentric_temp;
+                    tMax = dist_temp; // tMax is hit.dist
+                }
+                return false; // we want the closest hit, keep going
+            });
+            return hit.hit_ID < 0 ? false : true;
+        }
+
+        // true if the ray hits any triangle closer than tMax. unlike closestHit, this returns as soon as it finds one,
+        // which is all shadow rays need. uses the acceleration structure if there is one for this vertex list
+        bool occluded(const Ray & ray,
+                      float tMax,
+                      const std::vector<vertex> &vts) const{
+            const std::vector<triangle> *tris = compact_triangles && compact_triangles->size() == vts.size() / 3 ?
+                                                compact_triangles : nullptr;
+
+            if (!bvh || bvh->primitiveCount() != vts.size() / 3)
+                return tris ? rayModelOcclusion(ray, tMax, *tris) : rayModelOcclusion(ray, tMax, vts);
+
+            bool blocked = false;
+            float range = tMax; // traverse shrinks the range for closest hits, we never do
+            bvh->traverse(ray, range, [&](unsigned int tri, float &){
+                unsigned int i = tri * 3;
+                float dist_temp;
+                vec3 barycentric_temp;
+                bool intersects = tris ? rayTriangleIntersection(ray, (*tris)[tri], dist_temp, barycentric_temp) :
+                                  rayTriangleIntersection(ray, vts[i], vts[i+1], vts[i+2], dist_temp, barycentric_temp);
+                blocked = intersects && dist_temp < tMax;
+                return blocked; // any hit will do, stop at the first one
+            });
+            return blocked;
+        }
+
+        // same as the vertex list version below, but only reads the compact triangles
+        static bool rayModelOcclusion(const Ray & ray,
+                                      float tMax,
+                                      const std::vector<triangle> &tris){
+            for (unsigned int i = 0; i < tris.size(); i++)
+            {
+                float dist_temp;
+                vec3 barycentric_temp;
+                if (rayTriangleIntersection(ray, tris[i], dist_temp, barycentric_temp) && dist_temp < tMax)
+                    return true;
+            }
+            return false;
+        }
+
+        // returns true if any triangle is hit closer than tMax
+        static bool rayModelOcclusion(const Ray & ray,
+                                      float tMax,
+                                      const std::vector<vertex> &vts){
+            for (unsigned int i = 0; i < vts.size(); i+=3)
+            {
+                float dist_temp;
+                vec3 barycentric_temp;
+                if (rayTriangleIntersection(ray, vts[i], vts[i+1], vts[i+2], dist_temp, barycentric_temp) && dist_temp < tMax)
+                    return true;
+            }
+            return false;
+        }
+
+        // same as the vertex list version below, but only reads the compact triangles
+        static bool rayModelIntersection(const Ray & ray,
+                                         const std::vector<triangle> &tris,
+                                         Hit &hit){
+            for (unsigned int i = 0; i < tris.size(); i++)
+            {
+                float dist_temp;
+                vec3 barycentric_temp;
+                if (rayTriangleIntersection(ray, tris[i], dist_temp, barycentric_temp) && dist_temp < hit.dist)
+                {
+                    hit.hit_ID = (int) i * 3;
+                    hit.dist = dist_temp;
+                    hit.barycentric = barycentric_temp;
+                }
+            }
+            return hit.hit_ID < 0 ? false : true;
         }
 
         // returns false if no intersection
@@ -144,8 +768,26 @@ namespace rt{
                                             const vertex & p3,
                                             float & t, vec3 & barycentric)
         {
-            vec3 e1 = p2.pos - p1.pos;
-            vec3 e2 = p3.pos - p1.pos;
+            return rayTriangleIntersection(ray, vec3(p1.pos), p2.pos - p1.pos, p3.pos - p1.pos, t, barycentric);
+        }
+
+        // returns false if no intersection
+        static bool rayTriangleIntersection(const Ray & ray,
+                                            const triangle & tri,
+                                            float & t, vec3 & barycentric)
+        {
+            return rayTriangleIntersection(ray, tri.v0, tri.e1, tri.e2, t, barycentric);
+        }
+
+        // returns false if no intersection
+        // the triangle is given by its first vertex, p1, and the edges e1 = p2 - p1 and e2 = p3 - p1
+        static bool rayTriangleIntersection(const Ray & ray,
+                                            const vec3 & p1,
+                                            const vec3 & e1,
+                                            const vec3 & e2,
+                                            float & t, vec3 & barycentric)
+        {
+            RT_COUNT(threadTriangleTests()++);
             vec3 q = cross(ray.direction, e2);
             float a = dot(e1, q);
 
@@ -154,7 +796,7 @@ namespace rt{
             if (abs(a) < tolerance) return false;
 
             float f = 1.0f / a;
-            vec3 s = ray.origin - vec3(p1.pos);
+            vec3 s = ray.origin - p1;
             float u = f * dot(s, q);
 
             // if u < 0, intersection with plane is not within the triangle
@@ -0,0 +1,115 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_SCENE_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_SCENE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "rt_types.h"
+#include "rt_bvh.h"
+
+namespace rt{
+    using namespace glm;
+
+    // geometry that can be placed in a Scene any number of times. the triangles and the hierarchy over them are in
+    // the space of the mesh, and are shared by all its instances
+    struct Mesh{
+        // flat vertex list, 3 vertices per triangle, as the ones passed to Renderer::render
+        std::vector<vertex> vertices;
+        // intersection-only copy of the triangles, see makeTriangles
+        std::vector<triangle> triangles;
+        BVH bvh;
+        AABB bounds;
+
+        explicit Mesh(std::vector<vertex> vts) : vertices(std::move(vts)) {
+            triangles = makeTriangles(vertices);
+            bvh.build(vertices);
+            for (const vertex &v : vertices) bounds.grow(vec3(v.pos));
+            bounds.pad();
+        }
+    };
+
+    // a mesh placed in the scene
+    struct Instance{
+        unsigned int mesh;
+        // from the space of the mesh to the space of the scene, and back
+        mat4 model;
+        mat4 world_to_model;
+        // transforms the normals of the mesh to the space of the scene
+        mat3 normal_matrix;
+        // bounds of the transformed mesh, in the space of the scene
+        AABB bounds;
+    };
+
+    // two level scene: meshes, each with its own hierarchy, and instances of them, with a hierarchy over the bounds of
+    // the instances on top. repeating a mesh costs one Instance, not a copy of its triangles.
+    // like BVH, the scene only holds the data, the intersection tests are done by the Renderer, which moves the rays
+    // to the space of each instance they reach (as ImagePlane moves them from the camera to the model)
+    class Scene{
+        std::vector<Mesh> meshes;
+        std::vector<Instance> instances;
+        // hierarchy over the instances, primitive i is instances[i]
+        BVH top;
+
+    public:
+        // returns the index of the mesh, to be used with addInstance
+        unsigned int addMesh(std::vector<vertex> vts){
+            meshes.emplace_back(std::move(vts));
+            return (unsigned int) meshes.size() - 1;
+        }
+
+        // places the mesh in the scene with the model matrix m, returns the index of the instance.
+        // build must be called after the last instance is added or moved
+        unsigned int addInstance(unsigned int mesh, const mat4 &m){
+            instances.emplace_back();
+            instances.back().mesh = mesh;
+            setTransform((unsigned int) instances.size() - 1, m);
+            return (unsigned int) instances.size() - 1;
+        }
+
+        void setTransform(unsigned int instance, const mat4 &m){
+            Instance &inst = instances[instance];
+            inst.model = m;
+            inst.world_to_model = inverse(m);
+            inst.normal_matrix = transpose(inverse(mat3(m)));
+
+            // the box around the 8 transformed corners of the box of the mesh
+            const AABB &b = meshes[inst.mesh].bounds;
+            inst.bounds = AABB();
+            for (unsigned int corner = 0; corner < 8; corner++) {
+                vec3 p(corner & 1 ? b.max.x : b.min.x, corner & 2 ? b.max.y : b.min.y, corner & 4 ? b.max.z : b.min.z);
+                inst.bounds.grow(vec3(m * vec4(p, 1)));
+            }
+        }
+
+        // (re)builds the top level hierarchy, the hierarchies of the meshes are built by addMesh
+        void build(){
+            std::vector<AABB> bounds(instances.size());
+            for (unsigned int i = 0; i < instances.size(); i++) bounds[i] = instances[i].bounds;
+            top.build(bounds);
+        }
+
+        const BVH &topLevel() const { return top; }
+        const Mesh &mesh(unsigned int i) const { return meshes[i]; }
+        const Instance &instance(unsigned int i) const { return instances[i]; }
+        unsigned int meshCount() const { return (unsigned int) meshes.size(); }
+        unsigned int instanceCount() const { return (unsigned int) instances.size(); }
+
+        // triangles the scene would have if every instance was a copy of its mesh
+        size_t triangleCount() const {
+            size_t count = 0;
+            for (const Instance &inst : instances) count += meshes[inst.mesh].triangles.size();
+            return count;
+        }
+
+        // memory used by the geometry and the hierarchies, in bytes
+        size_t memoryBytes() const {
+            size_t bytes = instances.size() * sizeof(Instance) + top.nodes.size() * sizeof(BVHNode) +
+                           top.indices.size() * sizeof(unsigned int);
+            for (const Mesh &m : meshes)
+                bytes += m.vertices.size() * sizeof(vertex) + m.triangles.size() * sizeof(triangle) +
+                         m.bvh.nodes.size() * sizeof(BVHNode) + m.bvh.indices.size() * sizeof(unsigned int);
+            return bytes;
+        }
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_SCENE_H
@@ -0,0 +1,52 @@
+#ifndef ITU_GRAPHICS_PROGRAMMING_RT_TILE_POOL_H
+#define ITU_GRAPHICS_PROGRAMMING_RT_TILE_POOL_H
+
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace rt{
+
+    // hands out tile indices in [0, tileCount) to a fixed number of workers, each tile exactly once.
+    // every worker starts with its own contiguous range of tiles (neighbouring tiles share cache lines of geometry),
+    // and when it runs out it steals from the ranges of the other workers, so that a worker that got the
+    // cheap part of the image (e.g. background) does not sit idle while the others finish.
+    class TilePool{
+        struct Range{
+            std::atomic<unsigned int> next;
+            unsigned int end;
+            // keep every range in its own cache line, workers hammer on their own counter
+            char padding[64 - sizeof(std::atomic<unsigned int>) - sizeof(unsigned int)];
+        };
+
+        std::unique_ptr<Range[]> ranges;
+        unsigned int workerCount;
+
+        // takes the next tile from a range, fails if the range is exhausted
+        static bool take(Range &range, unsigned int &tile){
+            // cheap check first so that thieves don't keep incrementing counters that are already past the end
+            if (range.next.load(std::memory_order_relaxed) >= range.end) return false;
+            tile = range.next.fetch_add(1, std::memory_order_relaxed);
+            return tile < range.end;
+        }
+
+    public:
+        TilePool(unsigned int tileCount, unsigned int workers) : ranges(new Range[workers]), workerCount(workers) {
+            for (unsigned int w = 0; w < workers; w++) {
+                ranges[w].next = (unsigned int) ((unsigned long long) tileCount * w / workers);
+                ranges[w].end = (unsigned int) ((unsigned long long) tileCount * (w + 1) / workers);
+            }
+        }
+
+        // returns false once there are no tiles left for anyone
+        bool next(unsigned int worker, unsigned int &tile){
+            if (take(ranges[worker], tile)) return true;
+            for (unsigned int i = 1; i < workerCount; i++) {
+                if (take(ranges[(worker + i) % workerCount], tile)) return true;
+            }
+            return false;
+        }
+    };
+}
+
+#endif //ITU_GRAPHICS_PROGRAMMING_RT_TILE_POOL_H
@@ -5,8 +5,19 @@
 #ifndef ITU_GRAPHICS_PROGRAMMING_RT_TYPES_H
 #define ITU_GRAPHICS_PROGRAMMING_RT_TYPES_H
 
+#include <vector>
+#include <string>
+#include <cstdio>
 #include "glm/glm.hpp"
 
+// RT_COUNT(statement) runs the statement only when the ray tracer is built with RT_ENABLE_COUNTERS (a cmake option),
+// it is used for the detailed counters of RayStats, which otherwise don't exist and cost nothing
+#ifdef RT_ENABLE_COUNTERS
+#define RT_COUNT(statement) statement
+#else
+#define RT_COUNT(statement)
+#endif
+
 namespace rt{
     namespace Colors {
         // color is a vec4
@@ -31,6 +42,7 @@ namespace rt{
     }
 
     struct Ray{
+        Ray() = default;
         Ray(glm::vec3 orig, glm::vec3 dir): origin(orig), direction(dir){};
         glm::vec3 origin;
         glm::vec3 direction;
@@ -38,10 +50,77 @@ namespace rt{
 
     struct Hit{
         int hit_ID = -1; // negative values for no hit, other values for the index of the first vertex in a triangle
+        int instance_ID = -1; // when tracing a Scene, the instance whose mesh hit_ID refers to
         glm::vec3 barycentric; // the barycentric coordinates of the triangle that was hit (if any)
         float dist = FLT_MAX;  // used to store the intersection distance
     };
 
+#ifdef RT_ENABLE_COUNTERS
+    // size of the depth histogram of RayStats, deeper rays are counted in the last bin
+    const unsigned int counted_depths = 8;
+
+    // triangle tests done by the calling thread, the renderer moves them into the RayStats of the thread after each
+    // tile, so the intersection functions don't need to know about RayStats
+    inline unsigned long long &threadTriangleTests(){
+        static thread_local unsigned long long tests = 0;
+        return tests;
+    }
+#endif
+
+    // number of rays traced, by type. every render thread counts in its own RayStats, they are added up at the end
+    struct RayStats{
+        unsigned long long primary = 0;
+        unsigned long long shadow = 0;
+        unsigned long long secondary = 0; // reflection rays
+        // pixels traced again with several samples by adaptive anti-aliasing, see Renderer::setAdaptiveSampling
+        unsigned long long supersampled = 0;
+
+#ifdef RT_ENABLE_COUNTERS
+        unsigned long long triangleTests = 0;
+        // primary and reflection rays that hit or missed the model, and shadow rays that found something in the way
+        unsigned long long hits = 0, misses = 0;
+        unsigned long long occluded = 0;
+        // primary and reflection rays by the number of reflections before them, [0] are the primary rays
+        unsigned long long depthHistogram[counted_depths] = {};
+
+        void countRay(unsigned int bounces, bool hit){
+            depthHistogram[bounces < counted_depths ? bounces : counted_depths - 1]++;
+            if (hit) hits++;
+            else misses++;
+        }
+
+        // e.g. "tests/ray: 3.1 - hits: 95% - occluded: 20% - depths: 4096 3891 3760"
+        std::string describeCounters() const{
+            char text[128];
+            unsigned long long rays = total() > 0 ? total() : 1;
+            snprintf(text, sizeof(text), "tests/ray: %.1f - hits: %.0f%% - occluded: %.0f%% - depths:",
+                     double(triangleTests) / rays, 100.0 * hits / (hits + misses > 0 ? hits + misses : 1),
+                     100.0 * occluded / (shadow > 0 ? shadow : 1));
+            std::string description = text;
+            for (unsigned int d = 0; d < counted_depths && depthHistogram[d] > 0; d++)
+                description += " " + std::to_string(depthHistogram[d]);
+            return description;
+        }
+#endif
+
+        unsigned long long total() const { return primary + shadow + secondary; }
+
+        RayStats& operator+=(const RayStats &other){
+            primary += other.primary;
+            shadow += other.shadow;
+            secondary += other.secondary;
+            supersampled += other.supersampled;
+#ifdef RT_ENABLE_COUNTERS
+            triangleTests += other.triangleTests;
+            hits += other.hits;
+            misses += other.misses;
+            occluded += other.occluded;
+            for (unsigned int d = 0; d < counted_depths; d++) depthHistogram[d] += other.depthHistogram[d];
+#endif
+            return *this;
+        }
+    };
+
     struct vertex {
         glm::vec4 pos;
         glm::vec4 norm;
@@ -64,6 +143,31 @@ namespace rt{
             return vertex{v1.pos + v2.pos, v1.norm + v2.norm, v1.col + v2.col, v1.uv + v2.uv};
         }
     };
+
+    // the part of a triangle the intersection test needs: its first vertex and the two edges that leave from it.
+    // that is 48 bytes, against the 3 * 56 bytes of its three vertices, most of which (normals, colors, uvs) are only
+    // needed to shade the closest hit. the padding and 16-byte alignment let each row be read with one aligned SSE load
+    struct alignas(16) triangle {
+        glm::vec3 v0;
+        float pad0;
+        glm::vec3 e1;
+        float pad1;
+        glm::vec3 e2;
+        float pad2;
+    };
+    static_assert(sizeof(triangle) == 48, "triangle is expected to be packed in 48 bytes");
+
+    // triangle i is made of vts[3i], vts[3i+1] and vts[3i+2]
+    inline std::vector<triangle> makeTriangles(const std::vector<vertex> &vts){
+        std::vector<triangle> tris(vts.size() / 3);
+        for (size_t i = 0; i < tris.size(); i++){
+            tris[i].v0 = vts[i * 3].pos;
+            tris[i].e1 = vts[i * 3 + 1].pos - vts[i * 3].pos;
+            tris[i].e2 = vts[i * 3 + 2].pos - vts[i * 3].pos;
+            tris[i].pad0 = tris[i].pad1 = tris[i].pad2 = 0;
+        }
+        return tris;
+    }
 }
 
 #endif //ITU_GRAPHICS_PROGRAMMING_RT_TYPES_H
@@ -6,8 +6,29 @@
 
 #include <vector>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
 #include <string>
 #include <cstring>
+#include <cfloat>
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+// keep windows.h from defining min and max macros, and from pulling in most of the API
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include <glm/glm.hpp>
 
@@ -23,125 +44,521 @@
 // - More secure. Change another line and you can inject code.
 // - Loading from memory, stream, etc
 
+// the file is mapped to memory and parsed on several threads, with a scanner that reads numbers the way fscanf does (and
+// gives the same floats), but without going through the C library for every token
+namespace OBJLoader {
+
+    // read-only view of a whole file
+    class MappedFile {
+        const char *bytes = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE, mapping = NULL;
+#endif
+
+    public:
+        MappedFile() = default;
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+        ~MappedFile() { close(); }
+
+        bool open(const char *path) {
+            close();
+#ifdef _WIN32
+            file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize)) { close(); return false; }
+            length = (size_t) fileSize.QuadPart;
+            // an empty file can't be mapped, but it is a valid (empty) model
+            if (length == 0) return true;
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping == NULL) { close(); return false; }
+            bytes = (const char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (bytes == NULL) { close(); return false; }
+#else
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0) return false;
+            struct stat info;
+            if (fstat(fd, &info) != 0) { ::close(fd); return false; }
+            length = (size_t) info.st_size;
+            if (length == 0) { ::close(fd); return true; }
+            void *view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            // the mapping keeps the file alive, we don't need the descriptor anymore
+            ::close(fd);
+            if (view == MAP_FAILED) { length = 0; return false; }
+            // we read the file from start to end once
+            madvise(view, length, MADV_SEQUENTIAL);
+            bytes = (const char *) view;
+#endif
+            return true;
+        }
 
+        void close() {
+#ifdef _WIN32
+            if (bytes) UnmapViewOfFile(bytes);
+            if (mapping != NULL) CloseHandle(mapping);
+            if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+            mapping = NULL;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (bytes) munmap((void *) bytes, length);
+#endif
+            bytes = nullptr;
+            length = 0;
+        }
 
-bool loadOBJ(
-        const char * path,
-        std::vector<float> & out_vertices,
-        std::vector<float> & out_uvs,
-        std::vector<float> & out_normals
-){
-    printf("Loading OBJ file %s...\n", path);
+        const char *data() const { return bytes; }
+        size_t size() const { return length; }
+    };
 
-    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-    std::vector<float> temp_vertices;
-    std::vector<float> temp_uvs;
-    std::vector<float> temp_normals;
+    // what a file holds, before the faces are expanded to one vertex per corner
+    struct Data {
+        // 3 floats per position and normal, 2 per uv (with v already inverted)
+        std::vector<float> positions, uvs, normals;
+        // 1-based (relative indices are made absolute), 3 per triangle, quads are split in two triangles
+        std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+    };
 
+    inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f'; }
+    inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
 
-    FILE * file = fopen(path, "r");
-    if( file == NULL ){
-        printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-        getchar();
-        return false;
+    // reads the text in [p, end)
+    struct Scanner {
+        const char *p, *end;
+
+        void skipBlanks() { while (p < end && isBlank(*p)) p++; }
+
+        // moves to the start of the next line
+        void skipLine() {
+            const char *newline = (const char *) memchr(p, '\n', end - p);
+            p = newline ? newline + 1 : end;
+        }
+
+        // the next word of the line (what fscanf("%s") reads), empty at the end of the line
+        void word(const char *&begin, size_t &size) {
+            skipBlanks();
+            begin = p;
+            while (p < end && !isBlank(*p) && *p != '\n') p++;
+            size = p - begin;
+        }
+
+        bool accept(char c) {
+            if (p < end && *p == c) { p++; return true; }
+            return false;
+        }
+
+        bool readInt(int &value) {
+            skipBlanks();
+            const char *s = p;
+            bool negative = s < end && *s == '-';
+            if (s < end && (*s == '-' || *s == '+')) s++;
+            if (s == end || !isDigit(*s)) return false;
+            long long v = 0;
+            while (s < end && isDigit(*s)) v = v * 10 + (*s++ - '0');
+            value = (int) (negative ? -v : v);
+            p = s;
+            return true;
+        }
+
+        // reads a number like fscanf("%f") does, and gives exactly the same float. plain decimals with up to 19
+        // digits, which is what exporters write, are converted here, anything else goes through strtof
+        bool readFloat(float &value) {
+            skipBlanks();
+            const char *s = p;
+            bool negative = s < end && *s == '-';
+            if (s < end && (*s == '-' || *s == '+')) s++;
+
+            uint64_t mantissa = 0;
+            int digits = 0, exponent = 0;
+            bool anyDigit = false, exact = true;
+            for (; s < end && isDigit(*s); s++) {
+                anyDigit = true;
+                if (mantissa == 0 && *s == '0') continue;
+                if (digits++ < 19) mantissa = mantissa * 10 + (*s - '0');
+                else exact = false;
+            }
+            if (s < end && *s == '.') {
+                for (s++; s < end && isDigit(*s); s++) {
+                    anyDigit = true;
+                    if (mantissa == 0 && *s == '0') { exponent--; continue; }
+                    if (digits++ < 19) { mantissa = mantissa * 10 + (*s - '0'); exponent--; }
+                    else exact = false;
+                }
+            }
+            if (anyDigit && s < end && (*s == 'e' || *s == 'E')) {
+                const char *e = s + 1;
+                bool negativeExponent = e < end && *e == '-';
+                if (e < end && (*e == '-' || *e == '+')) e++;
+                if (e < end && isDigit(*e)) {
+                    int v = 0;
+                    for (; e < end && isDigit(*e); e++) if (v < 10000) v = v * 10 + (*e - '0');
+                    exponent += negativeExponent ? -v : v;
+                    s = e;
+                }
+            }
+
+            // a double holds every integer up to 2^53 and every power of ten up to 10^22 exactly, so the one
+            // multiplication or division below is correctly rounded to a double. rounding that double to a float
+            // gives the correctly rounded float too, unless the double fell exactly halfway between two floats
+            static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+                                            1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+            bool delimited = s == end || isBlank(*s) || *s == '\n' || *s == '/';
+            if (anyDigit && exact && delimited && mantissa <= (uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+                double d = exponent < 0 ? double(mantissa) / powers[-exponent] : double(mantissa) * powers[exponent];
+                uint64_t bits;
+                memcpy(&bits, &d, sizeof(bits));
+                bool halfway = (bits & ((uint64_t(1) << 29) - 1)) == (uint64_t(1) << 28);
+                if (d == 0 || (d >= FLT_MIN && d <= FLT_MAX && !halfway)) {
+                    value = negative ? -float(d) : float(d);
+                    p = s;
+                    return true;
+                }
+            }
+
+            // strtof needs a terminated string, numbers longer than this are not worth the trouble
+            char text[64];
+            size_t n = 0;
+            for (const char *c = p; c < end && n + 1 < sizeof(text) && !isBlank(*c) && *c != '\n' && *c != '/'; c++)
+                text[n++] = *c;
+            text[n] = '\0';
+            char *parsedEnd;
+            value = strtof(text, &parsedEnd);
+            if (parsedEnd == text) return false;
+            p += parsedEnd - text;
+            return true;
+        }
+    };
+
+    // what a line holds, given by its first word
+    enum class Record { Position, UV, Normal, Face, Other };
+
+    inline Record readRecord(Scanner &in) {
+        const char *word;
+        size_t size;
+        in.word(word, size);
+        if (size == 1 && word[0] == 'v') return Record::Position;
+        if (size == 2 && word[0] == 'v' && word[1] == 't') return Record::UV;
+        if (size == 2 && word[0] == 'v' && word[1] == 'n') return Record::Normal;
+        if (size == 1 && word[0] == 'f') return Record::Face;
+        return Record::Other;
+    }
+
+    struct Counts {
+        size_t positions = 0, uvs = 0, normals = 0, faces = 0;
+    };
+
+    // a piece of the file made of whole lines, parsed on its own thread
+    struct Chunk {
+        const char *begin, *end;
+        // positions, uvs and normals in this chunk, and in all the chunks before it (where this chunk's go in Data)
+        Counts count, before;
+        // the faces of the chunk, moved to Data once we know how many the chunks before it have
+        std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+        bool parsed = false;
+    };
+
+    // a single thread is faster for small files, creating threads costs more than parsing a chunk smaller than this
+    const size_t min_chunk_bytes = 1 << 20;
+
+    // calls f(i) for i in [0, n), each on its own thread (0 on the calling thread)
+    template<class F>
+    void parallelFor(unsigned int n, F f) {
+        std::vector<std::thread> threads;
+        for (unsigned int i = 1; i < n; i++) threads.emplace_back(f, i);
+        if (n > 0) f(0);
+        for (auto &thread : threads) thread.join();
     }
 
-    while( 1 ){
-
-        char lineHeader[128];
-        // read the first word of the line
-        int res = fscanf(file, "%s", lineHeader);
-        if (res == EOF)
-            break; // EOF = End Of File. Quit the loop.
-
-        // else : parse lineHeader
-
-        if ( strcmp( lineHeader, "v" ) == 0 ){
-            float x, y, z;
-            fscanf(file, "%f %f %f\n", &x, &y, &z );
-            temp_vertices.push_back(x);
-            temp_vertices.push_back(y);
-            temp_vertices.push_back(z);
-        }else if ( strcmp( lineHeader, "vt" ) == 0 ){
-            float u, v;
-            fscanf(file, "%f %f\n", &u, &v );
-            v = -v; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
-            temp_uvs.push_back(u);
-            temp_uvs.push_back(v);
-        }else if ( strcmp( lineHeader, "vn" ) == 0 ){
-            float nx, ny, nz;
-            fscanf(file, "%f %f %f\n", &nx, &ny, &nz );
-            temp_normals.push_back(nx);
-            temp_normals.push_back(ny);
-            temp_normals.push_back(nz);
-        }else if ( strcmp( lineHeader, "f" ) == 0 ){
-            std::string vertex1, vertex2, vertex3;
-            unsigned int vertexIndex[4], uvIndex[4], normalIndex[4];
-            int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                                 &vertexIndex[0], &uvIndex[0], &normalIndex[0],
-                                 &vertexIndex[1], &uvIndex[1], &normalIndex[1],
-                                 &vertexIndex[2], &uvIndex[2], &normalIndex[2],
-                                 &vertexIndex[3], &uvIndex[3], &normalIndex[3]);
-            if (matches != 9 && matches != 12){
+    // splits [0, n) into about equal ranges, one per thread (but no fewer than minSize elements per range), and
+    // calls f(begin, end) for each of them in parallel
+    template<class F>
+    void parallelRanges(size_t n, unsigned int threads, size_t minSize, F f) {
+        size_t ranges = std::max<size_t>(1, std::min<size_t>(threads, n / std::max<size_t>(1, minSize)));
+        parallelFor((unsigned int) ranges, [&](unsigned int r) { f(n * r / ranges, n * (r + 1) / ranges); });
+    }
+
+    // 0 threads means one per core
+    inline unsigned int threadCount(unsigned int threads) {
+        return threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    inline void count(Chunk &chunk) {
+        Scanner in{chunk.begin, chunk.end};
+        while (in.p < chunk.end) {
+            switch (readRecord(in)) {
+                case Record::Position: chunk.count.positions++; break;
+                case Record::UV: chunk.count.uvs++; break;
+                case Record::Normal: chunk.count.normals++; break;
+                case Record::Face: chunk.count.faces++; break;
+                default: break;
+            }
+            in.skipLine();
+        }
+    }
+
+    // 1-based index of a face corner, negative ones count back from the last element defined before the face
+    inline unsigned int absoluteIndex(int index, size_t defined) {
+        return index < 0 ? (unsigned int) (int64_t(defined) + index + 1) : (unsigned int) index;
+    }
+
+    // parses the lines of the chunk, positions, uvs and normals go straight to their place in data, faces are kept in
+    // the chunk. returns false if a face can't be read by our simple parser
+    inline bool parse(Chunk &chunk, Data &data) {
+        float *positions = data.positions.data() + chunk.before.positions * 3;
+        float *uvs = data.uvs.data() + chunk.before.uvs * 2;
+        float *normals = data.normals.data() + chunk.before.normals * 3;
+        Counts defined = chunk.before;
+        // room for triangles, quads need a second one
+        for (auto *indices : {&chunk.vertexIndices, &chunk.uvIndices, &chunk.normalIndices})
+            indices->reserve(chunk.count.faces * 3);
+
+        Scanner in{chunk.begin, chunk.end};
+        while (in.p < chunk.end) {
+            switch (readRecord(in)) {
+                case Record::Position: {
+                    float x = 0, y = 0, z = 0;
+                    in.readFloat(x) && in.readFloat(y) && in.readFloat(z);
+                    *positions++ = x;
+                    *positions++ = y;
+                    *positions++ = z;
+                    defined.positions++;
+                    break;
+                }
+                case Record::UV: {
+                    float u = 0, v = 0;
+                    in.readFloat(u) && in.readFloat(v);
+                    *uvs++ = u;
+                    *uvs++ = -v; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
+                    defined.uvs++;
+                    break;
+                }
+                case Record::Normal: {
+                    float nx = 0, ny = 0, nz = 0;
+                    in.readFloat(nx) && in.readFloat(ny) && in.readFloat(nz);
+                    *normals++ = nx;
+                    *normals++ = ny;
+                    *normals++ = nz;
+                    defined.normals++;
+                    break;
+                }
+                case Record::Face: {
+                    // only v/vt/vn corners, triangles and quads (corners after the fourth are ignored)
+                    int vertexIndex[4], uvIndex[4], normalIndex[4];
+                    unsigned int corners = 0;
+                    while (corners < 4) {
+                        in.skipBlanks();
+                        if (in.p == chunk.end || !(isDigit(*in.p) || *in.p == '-' || *in.p == '+')) break;
+                        if (!(in.readInt(vertexIndex[corners]) && in.accept('/') && in.readInt(uvIndex[corners]) &&
+                              in.accept('/') && in.readInt(normalIndex[corners])))
+                            return false;
+                        corners++;
+                    }
+                    if (corners < 3) return false;
+
+                    // if a quad is defined, load as a second triangle
+                    static const unsigned int triangles[2][3] = {{0, 1, 2}, {0, 2, 3}};
+                    for (unsigned int t = 0; t < corners - 2; t++) {
+                        for (unsigned int corner : triangles[t]) {
+                            chunk.vertexIndices.push_back(absoluteIndex(vertexIndex[corner], defined.positions));
+                            chunk.uvIndices.push_back(absoluteIndex(uvIndex[corner], defined.uvs));
+                            chunk.normalIndices.push_back(absoluteIndex(normalIndex[corner], defined.normals));
+                        }
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+            // anything else (comments, groups, materials...) and whatever is left of the line is skipped
+            in.skipLine();
+        }
+        return true;
+    }
+
+    // reads the whole file into data, printing what went wrong if it can't. the file is split in chunks of whole lines
+    // that are parsed in parallel: a first pass counts the positions, uvs and normals of each chunk, so that each chunk
+    // knows where its own go (the sum of the counts of the chunks before it) and can resolve relative indices, and the
+    // faces are stitched together the same way once every chunk is parsed
+    inline bool load(const char *path, Data &data, unsigned int threads) {
+        MappedFile file;
+        if (!file.open(path)) {
+            printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+            getchar();
+            return false;
+        }
+        const char *begin = file.data(), *end = file.data() + file.size();
+
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threadCount(threads), file.size() / min_chunk_bytes));
+        std::vector<Chunk> chunks(chunkCount);
+        const char *chunkBegin = begin;
+        for (size_t c = 0; c < chunkCount; c++) {
+            // every chunk but the last ends after the first newline past its share of the file
+            const char *chunkEnd = end;
+            if (c + 1 < chunkCount) {
+                const char *newline = (const char *) memchr(begin + file.size() * (c + 1) / chunkCount, '\n',
+                                                            end - (begin + file.size() * (c + 1) / chunkCount));
+                chunkEnd = newline ? newline + 1 : end;
+            }
+            chunks[c].begin = chunkBegin;
+            chunks[c].end = std::max(chunkBegin, chunkEnd);
+            chunkBegin = chunks[c].end;
+        }
+
+        parallelFor((unsigned int) chunkCount, [&](unsigned int c) { count(chunks[c]); });
+        Counts total;
+        for (Chunk &chunk : chunks) {
+            chunk.before = total;
+            total.positions += chunk.count.positions;
+            total.uvs += chunk.count.uvs;
+            total.normals += chunk.count.normals;
+            total.faces += chunk.count.faces;
+        }
+        data.positions.resize(total.positions * 3);
+        data.uvs.resize(total.uvs * 2);
+        data.normals.resize(total.normals * 3);
+
+        parallelFor((unsigned int) chunkCount, [&](unsigned int c) { chunks[c].parsed = parse(chunks[c], data); });
+        for (Chunk &chunk : chunks) {
+            if (!chunk.parsed) {
                 printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-                fclose(file);
                 return false;
             }
-            // triangle info
-            vertexIndices.push_back(vertexIndex[0]);
-            vertexIndices.push_back(vertexIndex[1]);
-            vertexIndices.push_back(vertexIndex[2]);
-            uvIndices    .push_back(uvIndex[0]);
-            uvIndices    .push_back(uvIndex[1]);
-            uvIndices    .push_back(uvIndex[2]);
-            normalIndices.push_back(normalIndex[0]);
-            normalIndices.push_back(normalIndex[1]);
-            normalIndices.push_back(normalIndex[2]);
-            if (matches == 12){
-                // if a quad is defined, load as a second triangle
-                vertexIndices.push_back(vertexIndex[0]);
-                vertexIndices.push_back(vertexIndex[2]);
-                vertexIndices.push_back(vertexIndex[3]);
-                uvIndices    .push_back(uvIndex[0]);
-                uvIndices    .push_back(uvIndex[2]);
-                uvIndices    .push_back(uvIndex[3]);
-                normalIndices.push_back(normalIndex[0]);
-                normalIndices.push_back(normalIndex[2]);
-                normalIndices.push_back(normalIndex[3]);
-            }
-        }else{
-            // Probably a comment, eat up the rest of the line
-            char stupidBuffer[1000];
-            fgets(stupidBuffer, 1000, file);
         }
 
+        // where the faces of each chunk go, a single chunk simply hands its faces over
+        std::vector<size_t> firstIndex(chunkCount + 1, 0);
+        for (size_t c = 0; c < chunkCount; c++) firstIndex[c + 1] = firstIndex[c] + chunks[c].vertexIndices.size();
+        if (chunkCount == 1) {
+            data.vertexIndices.swap(chunks[0].vertexIndices);
+            data.uvIndices.swap(chunks[0].uvIndices);
+            data.normalIndices.swap(chunks[0].normalIndices);
+        } else {
+            data.vertexIndices.resize(firstIndex[chunkCount]);
+            data.uvIndices.resize(firstIndex[chunkCount]);
+            data.normalIndices.resize(firstIndex[chunkCount]);
+        }
+
+        // every face must refer to existing positions, uvs and normals
+        std::vector<char> valid(chunkCount, 1);
+        parallelFor((unsigned int) chunkCount, [&](unsigned int c) {
+            const Chunk &chunk = chunks[c];
+            if (chunkCount > 1) {
+                std::copy(chunk.vertexIndices.begin(), chunk.vertexIndices.end(), data.vertexIndices.begin() + firstIndex[c]);
+                std::copy(chunk.uvIndices.begin(), chunk.uvIndices.end(), data.uvIndices.begin() + firstIndex[c]);
+                std::copy(chunk.normalIndices.begin(), chunk.normalIndices.end(), data.normalIndices.begin() + firstIndex[c]);
+            }
+            for (size_t i = firstIndex[c]; i < firstIndex[c + 1]; i++) {
+                valid[c] &= data.vertexIndices[i] - 1 < total.positions && data.uvIndices[i] - 1 < total.uvs &&
+                            data.normalIndices[i] - 1 < total.normals;
+            }
+        });
+        for (size_t c = 0; c < chunkCount; c++) {
+            if (!valid[c]) {
+                printf("File can't be read by our simple parser :-( A face refers to a missing vertex\n");
+                return false;
+            }
+        }
+        return true;
     }
 
+    // gives one index to each distinct (position, uv, normal) combination used by the face corners, in the order they
+    // are first seen. open addressing with linear probing, a slot holds the index of a vertex + 1 (0 is empty)
+    class VertexTable {
+        std::vector<unsigned int> slots;
+
+        static size_t hash(unsigned int v, unsigned int vt, unsigned int vn) {
+            uint64_t h = v * 0x9E3779B97F4A7C15ull ^ vt * 0xC2B2AE3D27D4EB4Full ^ vn * 0x165667B19E3779F9ull;
+            return (size_t) (h ^ (h >> 32));
+        }
+
+        size_t find(unsigned int v, unsigned int vt, unsigned int vn) const {
+            size_t mask = slots.size() - 1;
+            size_t i = hash(v, vt, vn) & mask;
+            while (slots[i] != 0) {
+                const unsigned int *t = &triplets[(slots[i] - 1) * 3];
+                if (t[0] == v && t[1] == vt && t[2] == vn) break;
+                i = (i + 1) & mask;
+            }
+            return i;
+        }
+
+    public:
+        // the 1-based position, uv and normal indices of each vertex
+        std::vector<unsigned int> triplets;
+
+        // expected: about how many distinct vertices there will be, the table grows past it if needed
+        explicit VertexTable(size_t expected) {
+            size_t capacity = 16;
+            while (capacity < expected * 2) capacity *= 2;
+            slots.resize(capacity, 0);
+            triplets.reserve(expected * 3);
+        }
+
+        unsigned int size() const { return (unsigned int) (triplets.size() / 3); }
+
+        unsigned int index(unsigned int v, unsigned int vt, unsigned int vn) {
+            size_t slot = find(v, vt, vn);
+            if (slots[slot] != 0) return slots[slot] - 1;
+
+            unsigned int vertex = size();
+            triplets.push_back(v);
+            triplets.push_back(vt);
+            triplets.push_back(vn);
+            slots[slot] = vertex + 1;
+            // keep the table at most half full, so that probe sequences stay short
+            if (size_t(vertex + 1) * 2 > slots.size()) {
+                slots.assign(slots.size() * 2, 0);
+                for (unsigned int i = 0; i <= vertex; i++)
+                    slots[find(triplets[i * 3], triplets[i * 3 + 1], triplets[i * 3 + 2])] = i + 1;
+            }
+            return vertex;
+        }
+    };
+}
+
+
+
+// threads: number of threads used to parse the file and build the output, 0 uses one per core (small files are always
+// read on the calling thread). the output doesn't depend on it
+bool loadOBJ(
+        const char * path,
+        std::vector<float> & out_vertices,
+        std::vector<float> & out_uvs,
+        std::vector<float> & out_normals,
+        unsigned int threads = 0
+){
+    printf("Loading OBJ file %s...\n", path);
+
+    OBJLoader::Data data;
+    threads = OBJLoader::threadCount(threads);
+    if (!OBJLoader::load(path, data, threads))
+        return false;
+
+    // the new vertices are added after whatever the vectors already hold
+    size_t corners = data.vertexIndices.size();
+    if (corners == 0)
+        return true;
+    float * vertices = &*out_vertices.insert(out_vertices.end(), corners * 3, 0.0f);
+    float * uvs = &*out_uvs.insert(out_uvs.end(), corners * 2, 0.0f);
+    float * normals = &*out_normals.insert(out_normals.end(), corners * 3, 0.0f);
+
     // For each vertex of each triangle
-    for( unsigned int i=0; i<vertexIndices.size(); i++ ){
-
-        // Get the indices of its attributes
-        unsigned int vertexIndex = vertexIndices[i];
-        unsigned int uvIndex = uvIndices[i];
-        unsigned int normalIndex = normalIndices[i];
-
-        // Get the attributes thanks to the index
-        float x = temp_vertices[ (vertexIndex-1) * 3 ];
-        float y = temp_vertices[ (vertexIndex-1) * 3 +1 ];
-        float z = temp_vertices[ (vertexIndex-1) * 3 +2 ];
-        float u = temp_uvs[ (uvIndex-1) * 2 ];
-        float v = temp_uvs[ (uvIndex-1) * 2 +1 ];
-        float nx = temp_normals[ (normalIndex-1) * 3 ];
-        float ny = temp_normals[ (normalIndex-1) * 3 +1 ];
-        float nz = temp_normals[ (normalIndex-1) * 3 +2 ];
-
-        // Put the attributes in buffers
-        out_vertices.push_back(x); out_vertices.push_back(y); out_vertices.push_back(z);
-        out_uvs.push_back(u); out_uvs.push_back(v);
-        out_normals.push_back(nx); out_normals.push_back(ny); out_normals.push_back(nz);
+    OBJLoader::parallelRanges(corners, threads, OBJLoader::min_chunk_bytes / 32, [&](size_t begin, size_t end){
+        for( size_t i=begin; i<end; i++ ){
 
-    }
-    fclose(file);
+            // Get the attributes thanks to the indices
+            const float * vertex = &data.positions[ (data.vertexIndices[i]-1) * 3 ];
+            const float * uv = &data.uvs[ (data.uvIndices[i]-1) * 2 ];
+            const float * normal = &data.normals[ (data.normalIndices[i]-1) * 3 ];
+
+            // Put the attributes in buffers
+            std::copy(vertex, vertex + 3, vertices + i * 3);
+            std::copy(uv, uv + 2, uvs + i * 2);
+            std::copy(normal, normal + 3, normals + i * 3);
+
+        }
+    });
     return true;
 }
 
@@ -151,110 +568,97 @@ bool loadOBJ(
         const char * path,
         std::vector<glm::vec3> & out_vertices,
         std::vector<glm::vec2> & out_uvs,
-        std::vector<glm::vec3> & out_normals
+        std::vector<glm::vec3> & out_normals,
+        unsigned int threads = 0
 ){
     printf("Loading OBJ file %s...\n", path);
 
-    std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-    std::vector<glm::vec3> temp_vertices;
-    std::vector<glm::vec2> temp_uvs;
-    std::vector<glm::vec3> temp_normals;
+    OBJLoader::Data data;
+    threads = OBJLoader::threadCount(threads);
+    if (!OBJLoader::load(path, data, threads))
+        return false;
 
+    // the new vertices are added after whatever the vectors already hold
+    size_t corners = data.vertexIndices.size();
+    if (corners == 0)
+        return true;
+    glm::vec3 * vertices = &*out_vertices.insert(out_vertices.end(), corners, glm::vec3(0));
+    glm::vec2 * uvs = &*out_uvs.insert(out_uvs.end(), corners, glm::vec2(0));
+    glm::vec3 * normals = &*out_normals.insert(out_normals.end(), corners, glm::vec3(0));
 
-    FILE * file = fopen(path, "r");
-    if( file == NULL ){
-        printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-        getchar();
-        return false;
-    }
+    // For each vertex of each triangle
+    OBJLoader::parallelRanges(corners, threads, OBJLoader::min_chunk_bytes / 32, [&](size_t begin, size_t end){
+        for( size_t i=begin; i<end; i++ ){
+
+            // Get the attributes thanks to the indices
+            const float * vertex = &data.positions[ (data.vertexIndices[i]-1) * 3 ];
+            const float * uv = &data.uvs[ (data.uvIndices[i]-1) * 2 ];
+            const float * normal = &data.normals[ (data.normalIndices[i]-1) * 3 ];
+
+            // Put the attributes in buffers
+            vertices[i] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+            uvs     [i] = glm::vec2(uv[0], uv[1]);
+            normals [i] = glm::vec3(normal[0], normal[1], normal[2]);
 
-    while( 1 ){
-
-        char lineHeader[128];
-        // read the first word of the line
-        int res = fscanf(file, "%s", lineHeader);
-        if (res == EOF)
-            break; // EOF = End Of File. Quit the loop.
-
-        // else : parse lineHeader
-
-        if ( strcmp( lineHeader, "v" ) == 0 ){
-            glm::vec3 vertex;
-            fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z );
-            temp_vertices.push_back(vertex);
-        }else if ( strcmp( lineHeader, "vt" ) == 0 ){
-            glm::vec2 uv;
-            fscanf(file, "%f %f\n", &uv.x, &uv.y );
-            uv.y = -uv.y; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
-            temp_uvs.push_back(uv);
-        }else if ( strcmp( lineHeader, "vn" ) == 0 ){
-            glm::vec3 normal;
-            fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z );
-            temp_normals.push_back(normal);
-        }else if ( strcmp( lineHeader, "f" ) == 0 ){
-            unsigned int vertexIndex[4], uvIndex[4], normalIndex[4];
-            int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                                 &vertexIndex[0], &uvIndex[0], &normalIndex[0],
-                                 &vertexIndex[1], &uvIndex[1], &normalIndex[1],
-                                 &vertexIndex[2], &uvIndex[2], &normalIndex[2],
-                                 &vertexIndex[3], &uvIndex[3], &normalIndex[3]);
-            if (matches != 9 && matches != 12){
-                printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-                fclose(file);
-                return false;
-            }
-            vertexIndices.push_back(vertexIndex[0]);
-            vertexIndices.push_back(vertexIndex[1]);
-            vertexIndices.push_back(vertexIndex[2]);
-            uvIndices    .push_back(uvIndex[0]);
-            uvIndices    .push_back(uvIndex[1]);
-            uvIndices    .push_back(uvIndex[2]);
-            normalIndices.push_back(normalIndex[0]);
-            normalIndices.push_back(normalIndex[1]);
-            normalIndices.push_back(normalIndex[2]);
-
-            if (matches == 12){
-                // if a quad is defined, load as a second triangle
-                vertexIndices.push_back(vertexIndex[0]);
-                vertexIndices.push_back(vertexIndex[2]);
-                vertexIndices.push_back(vertexIndex[3]);
-                uvIndices    .push_back(uvIndex[0]);
-                uvIndices    .push_back(uvIndex[2]);
-                uvIndices    .push_back(uvIndex[3]);
-                normalIndices.push_back(normalIndex[0]);
-                normalIndices.push_back(normalIndex[2]);
-                normalIndices.push_back(normalIndex[3]);
-            }
-        }else{
-            // Probably a comment, eat up the rest of the line
-            char stupidBuffer[1000];
-            fgets(stupidBuffer, 1000, file);
         }
+    });
+    return true;
+}
 
-    }
 
-    // For each vertex of each triangle
-    for( unsigned int i=0; i<vertexIndices.size(); i++ ){
 
-        // Get the indices of its attributes
-        unsigned int vertexIndex = vertexIndices[i];
-        unsigned int uvIndex = uvIndices[i];
-        unsigned int normalIndex = normalIndices[i];
+// indexed version, for glDrawElements: each distinct combination of position, uv and normal used by the faces is
+// stored once, and out_indices gets 3 indices per triangle into the vertices (counting the ones the vectors already
+// hold). a vertex is usually shared by about 6 triangles, so this is several times less data to store and transform
+bool loadOBJ(
+        const char * path,
+        std::vector<glm::vec3> & out_vertices,
+        std::vector<glm::vec2> & out_uvs,
+        std::vector<glm::vec3> & out_normals,
+        std::vector<unsigned int> & out_indices,
+        unsigned int threads = 0
+){
+    printf("Loading OBJ file %s...\n", path);
 
-        // Get the attributes thanks to the index
-        glm::vec3 vertex = temp_vertices[ vertexIndex-1 ];
-        glm::vec2 uv = temp_uvs[ uvIndex-1 ];
-        glm::vec3 normal = temp_normals[ normalIndex-1 ];
+    OBJLoader::Data data;
+    threads = OBJLoader::threadCount(threads);
+    if (!OBJLoader::load(path, data, threads))
+        return false;
 
-        // Put the attributes in buffers
-        out_vertices.push_back(vertex);
-        out_uvs     .push_back(uv);
-        out_normals .push_back(normal);
+    size_t corners = data.vertexIndices.size();
+    if (corners == 0)
+        return true;
+
+    // most corners that share a position share the uv and normal too, so there are about as many vertices as positions
+    OBJLoader::VertexTable table(data.positions.size() / 3);
+    unsigned int first = (unsigned int) out_vertices.size();
+    unsigned int * indices = &*out_indices.insert(out_indices.end(), corners, 0u);
+    for( size_t i=0; i<corners; i++ )
+        indices[i] = first + table.index(data.vertexIndices[i], data.uvIndices[i], data.normalIndices[i]);
+
+    size_t count = table.size();
+    glm::vec3 * vertices = &*out_vertices.insert(out_vertices.end(), count, glm::vec3(0));
+    glm::vec2 * uvs = &*out_uvs.insert(out_uvs.end(), count, glm::vec2(0));
+    glm::vec3 * normals = &*out_normals.insert(out_normals.end(), count, glm::vec3(0));
+
+    // For each distinct vertex
+    OBJLoader::parallelRanges(count, threads, OBJLoader::min_chunk_bytes / 32, [&](size_t begin, size_t end){
+        for( size_t i=begin; i<end; i++ ){
+
+            // Get the attributes thanks to the indices
+            const unsigned int * triplet = &table.triplets[ i * 3 ];
+            const float * vertex = &data.positions[ (triplet[0]-1) * 3 ];
+            const float * uv = &data.uvs[ (triplet[1]-1) * 2 ];
+            const float * normal = &data.normals[ (triplet[2]-1) * 3 ];
+
+            // Put the attributes in buffers
+            vertices[i] = glm::vec3(vertex[0], vertex[1], vertex[2]);
+            uvs     [i] = glm::vec2(uv[0], uv[1]);
+            normals [i] = glm::vec3(normal[0], normal[1], normal[2]);
 
-    }
-    fclose(file);
+        }
+    });
     return true;
 }
 
-
 #endif //GRAPHICSPROGRAMMINGEXERCISES_OBJLOADER_H
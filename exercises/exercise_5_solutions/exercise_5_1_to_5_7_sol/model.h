@@ -56,20 +56,23 @@ private:
         std::vector<glm::vec3> vertices;
         std::vector<glm::vec2> uvs;
         std::vector<glm::vec3> normals;
+        std::vector<unsigned int> indices;
 
-        loadOBJ(path.c_str(), vertices, uvs, normals);
-        meshes.push_back(processMesh(vertices, uvs, normals));
+        // indexed, so that vertices shared by several triangles are stored (and transformed) only once
+        loadOBJ(path.c_str(), vertices, uvs, normals, indices);
+        meshes.push_back(processMesh(vertices, uvs, normals, indices));
 
     }
 
 
     Mesh processMesh(const std::vector<glm::vec3> & inVertices,
                      const std::vector<glm::vec2> & inUvs,
-                     const std::vector<glm::vec3> & inNormals)
+                     const std::vector<glm::vec3> & inNormals,
+                     const std::vector<unsigned int> & indices)
     {
         // data to fill
         std::vector<Vertex> vertices;
-        std::vector<unsigned int> indices;
+        vertices.reserve(inVertices.size());
 
         // Walk through each of the mesh's vertices
         for(unsigned int i = 0; i < inVertices.size(); i++)
@@ -84,7 +87,6 @@ private:
             vertex.TexCoords = i < inUvs.size() ? inUvs[i] : glm::vec2(0.0f, 0.0f);
 
             vertices.push_back(vertex);
-            indices.push_back(i);
         }
 
         // return a mesh object created from the extracted mesh data
@@ -291,6 +291,9 @@ int main()
 
         glfwSwapBuffers( window );
         glfwPollEvents();
+
+        // upload the textures decoded since the last frame, see texture_loader.h
+        TextureLoader::instance().uploadFinished();
     }
 
     // Cleanup
@@ -368,6 +371,8 @@ void drawGui()
         }
         ImGui::Text( "Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate,
                      ImGui::GetIO().Framerate );
+        ImGui::Text( "Textures: %u, %.1f MB of video memory", TextureCache::instance().textureCount(),
+                     TextureCache::instance().gpuBytes() / (1024.0 * 1024.0) );
         ImGui::End();
     }
 
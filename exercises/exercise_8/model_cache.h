@@ -0,0 +1,209 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <mesh.h>
+#include <objloader.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+// binary cache of the meshes Model builds from a file with assimp, written next to the file the first time it is
+// imported and memory mapped on the next runs, so the model doesn't have to be imported and processed again.
+// the cache holds the vertices, indices and the texture paths of each mesh exactly as Model made them, and it is only
+// used if it was made from a file of the same size, modification time and contents (files the model refers to, like a
+// .mtl, are not checked) with the same version of this format and the same Vertex struct
+namespace MeshCache {
+
+    // bump when the layout of the file, or what Model stores in the meshes, changes
+    const uint32_t version = 1;
+    const char magic[8] = {'I', 'T', 'U', 'M', 'E', 'S', 'H', '\0'};
+    // the cache of "car/Paint_LOD0.obj" is "car/Paint_LOD0.obj.meshcache"
+    const char extension[] = ".meshcache";
+
+    // read-only view of a whole file, the one the OBJ loader maps its files with
+    using OBJLoader::MappedFile;
+
+    // identifies the version of the source file a cache was made from
+    struct Source {
+        uint64_t size = 0;
+        int64_t mtime = 0;
+        uint64_t hash = 0;
+    };
+
+    // 64 bit hash of the bytes, 8 at a time. not meant to resist tampering, only to notice that a file changed
+    inline uint64_t hash(const char *bytes, size_t length) {
+        uint64_t h = 0xCBF29CE484222325ull ^ length;
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8) {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+            h ^= h >> 29;
+        }
+        for (; i < length; i++) h = (h ^ (unsigned char) bytes[i]) * 0x100000001B3ull;
+        return h;
+    }
+
+    // fills source with the size, modification time and hash of the file at path
+    inline bool describe(const std::string &path, Source &source) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) return false;
+        MappedFile file;
+        if (!file.open(path.c_str())) return false;
+        source.size = file.size();
+        source.mtime = (int64_t) info.st_mtime;
+        source.hash = hash(file.data(), file.size());
+        return true;
+    }
+
+    // the file starts with a Header, followed by meshCount meshes, each of them a MeshHeader followed by its vertices,
+    // its indices and its textures (a TextureHeader and the characters of the type and the path, each record padded to
+    // 4 bytes so that everything stays aligned in the mapping)
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint64_t sourceSize;
+        int64_t sourceMtime;
+        uint64_t sourceHash;
+        uint32_t meshCount;
+        uint32_t padding;
+    };
+
+    struct MeshHeader {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t padding;
+    };
+
+    struct TextureHeader {
+        uint32_t typeLength;
+        uint32_t pathLength;
+    };
+
+    inline size_t padded(size_t n) { return (n + 3) & ~size_t(3); }
+
+    // a mesh of the cache, the vertices and indices point into the mapped file
+    struct MeshView {
+        const Vertex *vertices;
+        size_t vertexCount;
+        const unsigned int *indices;
+        size_t indexCount;
+        // type and path of each texture, as in Texture
+        std::vector<std::pair<std::string, std::string>> textures;
+    };
+
+    class Reader {
+        MappedFile file;
+        std::vector<MeshView> views;
+
+    public:
+        // maps the cache at path, and checks that it is complete and that it was made from source. returns false if the
+        // cache can't be used, in that case the model must be imported again
+        bool open(const std::string &path, const Source &source) {
+            views.clear();
+            if (!file.open(path.c_str())) return false;
+            const char *p = file.data(), *end = file.data() + file.size();
+
+            Header header;
+            if (size_t(end - p) < sizeof(Header)) return false;
+            memcpy(&header, p, sizeof(Header));
+            p += sizeof(Header);
+            if (memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version ||
+                header.vertexSize != sizeof(Vertex) || header.sourceSize != source.size ||
+                header.sourceMtime != source.mtime || header.sourceHash != source.hash)
+                return false;
+
+            for (uint32_t m = 0; m < header.meshCount; m++) {
+                MeshHeader mesh;
+                if (size_t(end - p) < sizeof(MeshHeader)) return false;
+                memcpy(&mesh, p, sizeof(MeshHeader));
+                p += sizeof(MeshHeader);
+
+                MeshView view;
+                view.vertexCount = mesh.vertexCount;
+                view.indexCount = mesh.indexCount;
+                if (size_t(end - p) / sizeof(Vertex) < view.vertexCount) return false;
+                view.vertices = reinterpret_cast<const Vertex *>(p);
+                p += view.vertexCount * sizeof(Vertex);
+                if (size_t(end - p) / sizeof(unsigned int) < view.indexCount) return false;
+                view.indices = reinterpret_cast<const unsigned int *>(p);
+                p += view.indexCount * sizeof(unsigned int);
+
+                for (uint32_t t = 0; t < mesh.textureCount; t++) {
+                    TextureHeader texture;
+                    if (size_t(end - p) < sizeof(TextureHeader)) return false;
+                    memcpy(&texture, p, sizeof(TextureHeader));
+                    p += sizeof(TextureHeader);
+                    size_t length = padded(size_t(texture.typeLength) + texture.pathLength);
+                    if (size_t(end - p) < length) return false;
+                    view.textures.emplace_back(std::string(p, texture.typeLength),
+                                               std::string(p + texture.typeLength, texture.pathLength));
+                    p += length;
+                }
+                views.push_back(std::move(view));
+            }
+            return true;
+        }
+
+        size_t meshCount() const { return views.size(); }
+        const MeshView &mesh(size_t i) const { return views[i]; }
+    };
+
+    inline void append(std::vector<char> &out, const void *data, size_t length) {
+        out.insert(out.end(), (const char *) data, (const char *) data + length);
+    }
+
+    // writes the cache of meshes, made from source, to path. the file is written under another name and then renamed,
+    // so that a run that stops halfway (or a second instance reading it meanwhile) never sees half a cache
+    inline bool write(const std::string &path, const Source &source, const std::vector<Mesh> &meshes) {
+        std::vector<char> out;
+        Header header = {};
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.vertexSize = sizeof(Vertex);
+        header.sourceSize = source.size;
+        header.sourceMtime = source.mtime;
+        header.sourceHash = source.hash;
+        header.meshCount = (uint32_t) meshes.size();
+        append(out, &header, sizeof(Header));
+
+        for (const Mesh &mesh : meshes) {
+            MeshHeader meshHeader = {(uint32_t) mesh.vertices.size(), (uint32_t) mesh.indices.size(),
+                                     (uint32_t) mesh.textures.size(), 0};
+            append(out, &meshHeader, sizeof(MeshHeader));
+            append(out, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            append(out, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            for (const Texture &texture : mesh.textures) {
+                TextureHeader textureHeader = {(uint32_t) texture.type.size(), (uint32_t) texture.path.size()};
+                append(out, &textureHeader, sizeof(TextureHeader));
+                append(out, texture.type.data(), texture.type.size());
+                append(out, texture.path.data(), texture.path.size());
+                out.resize(out.size() + padded(texture.type.size() + texture.path.size()) -
+                           texture.type.size() - texture.path.size(), 0);
+            }
+        }
+
+        std::string temporary = path + ".tmp";
+        FILE *f = fopen(temporary.c_str(), "wb");
+        if (!f) return false;
+        bool written = fwrite(out.data(), 1, out.size(), f) == out.size();
+        written &= fclose(f) == 0;
+        // rename doesn't replace an existing file on windows
+        std::remove(path.c_str());
+        if (!written || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+#endif
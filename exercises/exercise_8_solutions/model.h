@@ -5,6 +5,7 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <texture_cache.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 #include <assimp/Importer.hpp>
@@ -12,6 +13,7 @@
 #include <assimp/postprocess.h>
 
 #include <mesh.h>
+#include <model_cache.h>
 #include <shader.h>
 
 #include <string>
@@ -22,7 +24,8 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false,
+                             glm::vec4 placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f));
 
 class Model
 {
@@ -40,6 +43,16 @@ public:
         loadModel(path);
     }
 
+    // the textures are shared with other models through the TextureCache, a copy would release them twice
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
+    ~Model()
+    {
+        for(const Texture &texture : textures_loaded)
+            TextureCache::instance().release(texture.id);
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader shader)
     {
@@ -50,8 +63,19 @@ public:
 private:
     /*  Functions   */
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // the meshes are read back from the cache of a previous import if there is one made from the same file (see
+    // model_cache.h), and a new cache is written after importing otherwise
     void loadModel(string const &path)
     {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        MeshCache::Source source;
+        bool cacheable = MeshCache::describe(path, source);
+        string cachePath = path + MeshCache::extension;
+        if(cacheable && loadCache(cachePath, source))
+            return;
+
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -61,11 +85,32 @@ private:
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        if(cacheable && !MeshCache::write(cachePath, source, meshes))
+            cout << "WARNING::MODEL:: could not write the cache " << cachePath << endl;
+    }
+
+    // builds the meshes from the cache at cachePath, if it was made from source
+    bool loadCache(string const &cachePath, const MeshCache::Source &source)
+    {
+        MeshCache::Reader cache;
+        if(!cache.open(cachePath, source))
+            return false;
+
+        for(size_t i = 0; i < cache.meshCount(); i++)
+        {
+            const MeshCache::MeshView &view = cache.mesh(i);
+            vector<Texture> textures;
+            for(const auto &texture : view.textures)
+                textures.push_back(loadTexture(texture.second.c_str(), texture.first));
+            meshes.push_back(Mesh(vector<Vertex>(view.vertices, view.vertices + view.vertexCount),
+                                  vector<unsigned int>(view.indices, view.indices + view.indexCount),
+                                  textures));
+        }
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -176,75 +221,42 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory, type == aiTextureType_DIFFUSE);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(loadTexture(str.C_Str(), typeName));
         }
         return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    // returns the texture at path (relative to the directory of the model), loading it if it isn't loaded yet
+    Texture loadTexture(const char *path, const string &typeName)
     {
-        GLenum format, internalFormat;
-        if (nrComponents == 1)
-            internalFormat = format = GL_RED;
-        else if (nrComponents == 3)
-        {
-            format = GL_RGB;
-            internalFormat = gamma ? GL_SRGB : format;
-        }
-        else if (nrComponents == 4)
+        // check if texture was loaded before and if so, skip loading a new texture
+        for(unsigned int j = 0; j < textures_loaded.size(); j++)
         {
-            format = GL_RGBA;
-            internalFormat = gamma ? GL_SRGB_ALPHA : format;
+            if(std::strcmp(textures_loaded[j].path.data(), path) == 0)
+                return textures_loaded[j]; // a texture with the same filepath has already been loaded (optimization)
         }
+        // if texture hasn't been loaded already, load it. until it is decoded the texture is a single texel of mid grey,
+        // or of a flat normal for normal maps
+        glm::vec4 placeholder = typeName == "texture_normal" ? glm::vec4(0.5f, 0.5f, 1.0f, 1.0f) : glm::vec4(0.5f, 0.5f, 0.5f, 1.0f);
+        Texture texture;
+        texture.id = TextureFromFile(path, this->directory, typeName == "texture_diffuse", placeholder);
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
+    }
+};
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+// the texture of the file at directory/path from the TextureCache, which starts loading it on the worker threads of the
+// TextureLoader if no model has it yet. the id can be used right away, it shows the placeholder color until
+// TextureLoader::uploadFinished uploads the image (see texture_loader.h). it must be given back with
+// TextureCache::release
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, glm::vec4 placeholder)
+{
+    string filename = string(path);
+    filename = directory + '/' + filename;
 
-    return textureID;
+    return TextureCache::instance().acquire(filename, gamma, placeholder);
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <texture_loader.h>
+
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdlib>
+
+// the textures of every Model, shared by all of them: models that use the same image file (the parts of the car, for
+// example) get the same texture, decoded and uploaded once.
+// a texture is identified by the full path of its file and by whether it is sRGB encoded, the only setting that
+// changes how the same file ends up on the gpu (all of them are sampled with repeat and trilinear filtering).
+// acquire and release count the users of each texture. one that nobody uses any more stays in the cache, in case a
+// model needs it again, until the unused textures take more video memory than the budget (see setUnusedBudget)
+class TextureCache
+{
+public:
+    static TextureCache &instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // the texture of the file at path, loaded by the TextureLoader if the cache doesn't have it yet (placeholder is
+    // the color it has until then). every acquire must be matched by a release
+    unsigned int acquire(const std::string &path, bool gamma = false,
+                         glm::vec4 placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f))
+    {
+        Key key(canonicalPath(path), gamma);
+        auto found = entries.find(key);
+        if(found != entries.end())
+        {
+            found->second.users++;
+            return found->second.id;
+        }
+        Entry entry;
+        entry.id = TextureLoader::instance().load(path, gamma, placeholder);
+        entry.users = 1;
+        entries[key] = entry;
+        keys[entry.id] = key;
+        return entry.id;
+    }
+
+    void release(unsigned int id)
+    {
+        auto key = keys.find(id);
+        if(key == keys.end())
+            return;
+        Entry &entry = entries[key->second];
+        if(--entry.users == 0)
+        {
+            entry.released = ++releases;
+            evict(unusedBudget);
+        }
+    }
+
+    // deletes unused textures, the ones released longest ago first, until they take at most maxUnusedBytes
+    void evict(size_t maxUnusedBytes = 0)
+    {
+        size_t unused = unusedBytes();
+        while(unused > maxUnusedBytes || (maxUnusedBytes == 0 && unusedCount() > 0))
+        {
+            auto oldest = entries.end();
+            for(auto entry = entries.begin(); entry != entries.end(); ++entry)
+            {
+                if(entry->second.users == 0 && (oldest == entries.end() || entry->second.released < oldest->second.released))
+                    oldest = entry;
+            }
+            if(oldest == entries.end())
+                break;
+            unused -= TextureLoader::instance().bytes(oldest->second.id);
+            TextureLoader::instance().destroy(oldest->second.id);
+            keys.erase(oldest->second.id);
+            entries.erase(oldest);
+        }
+    }
+
+    // how much video memory the unused textures can keep, 64 MB unless changed
+    void setUnusedBudget(size_t bytes)
+    {
+        unusedBudget = bytes;
+        evict(unusedBudget);
+    }
+
+    unsigned int textureCount() const { return (unsigned int) entries.size(); }
+
+    // estimated video memory held by the textures in the cache, used or not. textures still being decoded count as 0
+    size_t gpuBytes() const
+    {
+        size_t bytes = 0;
+        for(const auto &entry : entries)
+            bytes += TextureLoader::instance().bytes(entry.second.id);
+        return bytes;
+    }
+
+    // the part of gpuBytes held by textures nobody uses
+    size_t unusedBytes() const
+    {
+        size_t bytes = 0;
+        for(const auto &entry : entries)
+        {
+            if(entry.second.users == 0)
+                bytes += TextureLoader::instance().bytes(entry.second.id);
+        }
+        return bytes;
+    }
+
+private:
+    typedef std::pair<std::string, bool> Key;
+    struct Entry
+    {
+        unsigned int id = 0;
+        unsigned int users = 0;
+        // when the last user released it, to evict the least recently used first
+        uint64_t released = 0;
+    };
+
+    std::map<Key, Entry> entries;
+    std::unordered_map<unsigned int, Key> keys;
+    uint64_t releases = 0;
+    size_t unusedBudget = size_t(64) << 20;
+
+    unsigned int unusedCount() const
+    {
+        unsigned int count = 0;
+        for(const auto &entry : entries)
+            count += entry.second.users == 0;
+        return count;
+    }
+
+    // the same file reached through different relative paths ("car/../car/paint.png") has a single entry
+    static std::string canonicalPath(const std::string &path)
+    {
+#ifdef _WIN32
+        char full[_MAX_PATH];
+        if(_fullpath(full, path.c_str(), _MAX_PATH))
+            return full;
+#else
+        char *full = realpath(path.c_str(), nullptr);
+        if(full)
+        {
+            std::string canonical(full);
+            free(full);
+            return canonical;
+        }
+#endif
+        return path;
+    }
+};
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+// only the declarations, model.h includes stb_image.h again with STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <thread>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+// decodes image files on a pool of worker threads, so that loading a model with many textures neither waits for one
+// image at a time nor stalls the render loop.
+// load gives back a texture right away, holding a single texel of a placeholder color, and the decoded image replaces
+// the placeholder in that same texture object (so the id handed out stays valid) when uploadFinished is called. the
+// worker threads only decode, every OpenGL call is made on the thread that calls load and uploadFinished
+class TextureLoader
+{
+public:
+    // the loader used by TextureFromFile
+    static TextureLoader &instance()
+    {
+        static TextureLoader loader;
+        return loader;
+    }
+
+    TextureLoader() = default;
+    TextureLoader(const TextureLoader &) = delete;
+    TextureLoader &operator=(const TextureLoader &) = delete;
+
+    // the textures don't outlive the OpenGL context, so they are not deleted here
+    ~TextureLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        requested.notify_all();
+        for(auto &worker : workers)
+            worker.join();
+        for(Job &job : finished)
+            stbi_image_free(job.data);
+    }
+
+    // creates the texture and queues the file to be decoded. gamma: the image is sRGB encoded
+    unsigned int load(const std::string &path, bool gamma = false,
+                      glm::vec4 placeholder = glm::vec4(0.5f, 0.5f, 0.5f, 1.0f))
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, gamma ? GL_SRGB_ALPHA : GL_RGBA, 1, 1, 0, GL_RGBA, GL_FLOAT, &placeholder[0]);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // the workers are started with the first texture, leaving a core to the thread that renders
+            if(workers.empty())
+            {
+                // hardware_concurrency can be 0 when it isn't known
+                unsigned int cores = std::thread::hardware_concurrency();
+                unsigned int count = cores > 1 ? cores - 1 : 1;
+                for(unsigned int i = 0; i < count; i++)
+                    workers.emplace_back(&TextureLoader::work, this);
+            }
+            Job job;
+            job.path = path;
+            job.id = textureID;
+            job.gamma = gamma;
+            waiting.push_back(std::move(job));
+            inFlight++;
+        }
+        requested.notify_one();
+        return textureID;
+    }
+
+    // uploads up to maxUploads of the images decoded so far, to be called once per frame on the OpenGL thread.
+    // returns how many of the textures requested are not uploaded yet
+    unsigned int uploadFinished(unsigned int maxUploads = 4)
+    {
+        std::vector<Job> ready;
+        // the ones destroyed while their image was being decoded, which are deleted instead
+        std::vector<char> destroyed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while(!finished.empty() && ready.size() < maxUploads)
+            {
+                ready.push_back(std::move(finished.front()));
+                finished.pop_front();
+                destroyed.push_back(orphaned.erase(ready.back().id) > 0);
+            }
+        }
+        for(size_t i = 0; i < ready.size(); i++)
+        {
+            if(destroyed[i])
+            {
+                stbi_image_free(ready[i].data);
+                glDeleteTextures(1, &ready[i].id);
+            }
+            else
+                sizes[ready[i].id] = upload(ready[i]);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight -= (unsigned int) ready.size();
+        return inFlight;
+    }
+
+    // deletes a texture made by load, whether its image is decoded yet or not
+    void destroy(unsigned int id)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto isJob = [id](const Job &job){ return job.id == id; };
+            auto queued = std::find_if(waiting.begin(), waiting.end(), isJob);
+            auto done = std::find_if(finished.begin(), finished.end(), isJob);
+            if(queued != waiting.end())
+            {
+                waiting.erase(queued);
+                inFlight--;
+            }
+            else if(done != finished.end())
+            {
+                stbi_image_free(done->data);
+                finished.erase(done);
+                inFlight--;
+            }
+            else if(decoding.count(id))
+            {
+                // a worker is decoding it, the texture is deleted once the image is back (see uploadFinished). until
+                // then OpenGL can't give the id to another texture
+                orphaned.insert(id);
+                return;
+            }
+        }
+        sizes.erase(id);
+        glDeleteTextures(1, &id);
+    }
+
+    // estimated video memory used by a texture made by load, 0 until its image is uploaded
+    size_t bytes(unsigned int id) const
+    {
+        auto size = sizes.find(id);
+        return size == sizes.end() ? 0 : size->second;
+    }
+
+    // waits until every texture requested so far is decoded and uploaded, on the OpenGL thread
+    void finish()
+    {
+        while(uploadFinished(~0u) > 0)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            decoded.wait(lock, [this]{ return !finished.empty(); });
+        }
+    }
+
+private:
+    struct Job
+    {
+        std::string path;
+        unsigned int id = 0;
+        bool gamma = false;
+        // filled by the worker, null if the file couldn't be decoded
+        unsigned char *data = nullptr;
+        int width = 0, height = 0, nrComponents = 0;
+    };
+
+    std::mutex mutex;
+    std::condition_variable requested, decoded;
+    std::deque<Job> waiting, finished;
+    std::vector<std::thread> workers;
+    // textures being decoded, and the ones among them that were destroyed meanwhile
+    std::set<unsigned int> decoding, orphaned;
+    // requested and not uploaded yet
+    unsigned int inFlight = 0;
+    // of the uploaded textures, only used on the OpenGL thread
+    std::unordered_map<unsigned int, size_t> sizes;
+    bool stopping = false;
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true)
+        {
+            requested.wait(lock, [this]{ return stopping || !waiting.empty(); });
+            if(stopping)
+                return;
+            Job job = std::move(waiting.front());
+            waiting.pop_front();
+            decoding.insert(job.id);
+
+            lock.unlock();
+            job.data = stbi_load(job.path.c_str(), &job.width, &job.height, &job.nrComponents, 0);
+            lock.lock();
+
+            decoding.erase(job.id);
+            finished.push_back(std::move(job));
+            decoded.notify_all();
+        }
+    }
+
+    // replaces the placeholder of the texture with the decoded image, the texture keeps the placeholder if the file
+    // couldn't be decoded. returns the estimated size of the texture in video memory
+    static size_t upload(const Job &job)
+    {
+        if(!job.data)
+        {
+            std::cout << "Texture failed to load at path: " << job.path << std::endl;
+            return 0;
+        }
+
+        GLenum format, internalFormat;
+        if(job.nrComponents == 1)
+            internalFormat = format = GL_RED;
+        else if(job.nrComponents == 2)
+            internalFormat = format = GL_RG;
+        else if(job.nrComponents == 3)
+        {
+            format = GL_RGB;
+            internalFormat = job.gamma ? GL_SRGB : format;
+        }
+        else
+        {
+            format = GL_RGBA;
+            internalFormat = job.gamma ? GL_SRGB_ALPHA : format;
+        }
+
+        glBindTexture(GL_TEXTURE_2D, job.id);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, job.width, job.height, 0, format, GL_UNSIGNED_BYTE, job.data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        stbi_image_free(job.data);
+
+        // drivers store 3 channel textures with 4, and the mipmaps add a third to the size of the image
+        size_t texel = job.nrComponents == 3 ? 4 : (size_t) job.nrComponents;
+        return size_t(job.width) * job.height * texel * 4 / 3;
+    }
+};
+
+#endif